@@ -0,0 +1,17 @@
+#!/usr/bin/env bash
+# Forward a Claude Code hook payload to a ToastWindow relay
+# (ToastWindow.exe --host --relay) on the Windows desktop.
+#
+# Use it as the hook command on the remote or WSL machine for
+# UserPromptSubmit, Stop, Notification and SessionEnd. The relay address
+# defaults to 127.0.0.1:9417, e.g. through `ssh -R 9417:127.0.0.1:9417`.
+
+host="${TOAST_RELAY_HOST:-127.0.0.1}"
+port="${TOAST_RELAY_PORT:-9417}"
+
+# The relay reads one JSON object per line; JSON strings never contain raw
+# newlines, so stripping them is safe
+payload="$(tr -d '\r\n')"
+
+{ printf '%s\n' "$payload" >"/dev/tcp/$host/$port"; } 2>/dev/null || true
+exit 0
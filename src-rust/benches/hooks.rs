@@ -0,0 +1,557 @@
+//! End-to-end latency benchmark for the hook modes.
+//!
+//! Runs the real ToastWindow binary the way the Claude Code hooks do and
+//! reports p50/p99 of:
+//! - hook return time: spawn to exit of `--save`, `--notify`, `--input`
+//! - time to first paint: spawn to the toast window becoming visible
+//!   (`--notify`, `--input` through the host, and standalone `--notify-show`)
+//! - time to activation: click on the toast to the saved window becoming
+//!   the foreground window
+//! - footprint: startup time (spawn to exit of a no-op `--cleanup`) and
+//!   peak working set of each hook process
+//!
+//! ```text
+//! cargo bench --bench hooks -- [--iterations N] [--depth N] [--wt-tabs N]
+//! ```
+//!
+//! `--depth` runs every hook under N nested `cmd /c` shells, giving the
+//! caller walk in process.rs a deeper tree to climb. `--wt-tabs` opens a
+//! Windows Terminal window with N tabs and adds the WT capture and tab
+//! switch scenarios. Toasts are shown and dismissed on the current desktop,
+//! so leave the machine alone while it runs.
+
+use std::io::Write;
+use std::os::windows::io::AsRawHandle;
+use std::os::windows::process::CommandExt;
+use std::process::{Command, Stdio};
+use std::time::{Duration, Instant};
+
+use windows::core::*;
+use windows::Win32::Foundation::*;
+use windows::Win32::System::LibraryLoader::GetModuleHandleW;
+use windows::Win32::UI::Input::KeyboardAndMouse::*;
+use windows::Win32::UI::WindowsAndMessaging::*;
+
+const EXE: &str = env!("CARGO_BIN_EXE_toast-window");
+
+const TOAST_CLASS: &str = "ClaudeCodeToast";
+const HOST_CLASS: &str = "ClaudeCodeToastHost";
+const WT_CLASS: &str = "CASCADIA_HOSTING_WINDOW_CLASS";
+const TARGET_CLASS: &str = "ToastBenchTarget";
+
+/// Prompt sizes (characters) used for the synthetic UserPromptSubmit payloads.
+const PROMPT_SIZES: &[usize] = &[0, 100, 10_000, 1_000_000];
+
+const TOAST_TIMEOUT: Duration = Duration::from_secs(5);
+const ACTIVATION_TIMEOUT: Duration = Duration::from_secs(3);
+
+struct Options {
+    iterations: usize,
+    depth: usize,
+    wt_tabs: usize,
+}
+
+fn parse_options() -> Options {
+    let mut options = Options { iterations: 20, depth: 0, wt_tabs: 0 };
+    let args: Vec<String> = std::env::args().collect();
+    let mut i = 1;
+    while i < args.len() {
+        let value = args.get(i + 1).and_then(|v| v.parse().ok());
+        match (args[i].as_str(), value) {
+            ("--iterations", Some(n)) => options.iterations = n,
+            ("--depth", Some(n)) => options.depth = n,
+            ("--wt-tabs", Some(n)) => options.wt_tabs = n,
+            // cargo bench passes --bench; ignore anything else
+            _ => {
+                i += 1;
+                continue;
+            }
+        }
+        i += 2;
+    }
+    options.iterations = options.iterations.max(1);
+    options
+}
+
+// --- Measurements ---
+
+#[derive(Default)]
+struct Report {
+    rows: Vec<(String, Vec<Duration>)>,
+    /// Peak working set samples in bytes
+    memory: Vec<(String, Vec<u64>)>,
+}
+
+impl Report {
+    fn add(&mut self, name: &str, samples: Vec<Duration>) {
+        if !samples.is_empty() {
+            self.rows.push((name.to_string(), samples));
+        }
+    }
+
+    fn add_memory(&mut self, name: &str, samples: Vec<u64>) {
+        if !samples.is_empty() {
+            self.memory.push((name.to_string(), samples));
+        }
+    }
+
+    fn print(&self) {
+        println!();
+        println!("{:<40} {:>5} {:>10} {:>10} {:>10}", "scenario", "n", "p50 ms", "p99 ms", "max ms");
+        for (name, samples) in &self.rows {
+            let mut sorted = samples.clone();
+            sorted.sort();
+            println!(
+                "{:<40} {:>5} {:>10.2} {:>10.2} {:>10.2}",
+                name,
+                sorted.len(),
+                ms(percentile(&sorted, 50.0)),
+                ms(percentile(&sorted, 99.0)),
+                ms(*sorted.last().unwrap()),
+            );
+        }
+
+        if self.memory.is_empty() {
+            return;
+        }
+        println!();
+        println!("{:<40} {:>5} {:>10} {:>10}", "peak working set", "n", "p50 KiB", "max KiB");
+        for (name, samples) in &self.memory {
+            let mut sorted = samples.clone();
+            sorted.sort();
+            let p50 = sorted[((sorted.len() - 1) as f64 * 0.5).round() as usize];
+            println!(
+                "{:<40} {:>5} {:>10} {:>10}",
+                name,
+                sorted.len(),
+                p50 / 1024,
+                sorted.last().unwrap() / 1024,
+            );
+        }
+    }
+}
+
+fn percentile(sorted: &[Duration], p: f64) -> Duration {
+    let rank = (p / 100.0 * (sorted.len() - 1) as f64).round() as usize;
+    sorted[rank.min(sorted.len() - 1)]
+}
+
+fn ms(d: Duration) -> f64 {
+    d.as_secs_f64() * 1000.0
+}
+
+// --- Running hooks ---
+
+/// Run the binary with `args` and `stdin`, optionally under `depth` nested
+/// shells. Returns the time from spawn to exit.
+fn run_hook(args: &str, stdin: &str, depth: usize) -> Duration {
+    let start = Instant::now();
+    let mut child = if depth == 0 {
+        Command::new(EXE).raw_arg(args).stdin(Stdio::piped()).spawn()
+    } else {
+        let shells = "cmd /c ".repeat(depth - 1);
+        Command::new("cmd")
+            .raw_arg(format!("/c {}\"{}\" {}", shells, EXE, args))
+            .stdin(Stdio::piped())
+            .spawn()
+    }
+    .expect("failed to start ToastWindow");
+
+    if let Some(mut pipe) = child.stdin.take() {
+        let _ = pipe.write_all(stdin.as_bytes());
+    }
+    let _ = child.wait();
+    start.elapsed()
+}
+
+/// PROCESS_MEMORY_COUNTERS from psapi.h.
+#[repr(C)]
+#[derive(Default)]
+struct ProcessMemoryCounters {
+    cb: u32,
+    page_fault_count: u32,
+    peak_working_set_size: usize,
+    working_set_size: usize,
+    quota_peak_paged_pool_usage: usize,
+    quota_paged_pool_usage: usize,
+    quota_peak_non_paged_pool_usage: usize,
+    quota_non_paged_pool_usage: usize,
+    pagefile_usage: usize,
+    peak_pagefile_usage: usize,
+}
+
+#[link(name = "kernel32")]
+extern "system" {
+    fn K32GetProcessMemoryInfo(process: HANDLE, counters: *mut ProcessMemoryCounters, cb: u32) -> BOOL;
+}
+
+/// Run the binary directly (no shells) and return the time from spawn to
+/// exit and the process's peak working set in bytes.
+fn run_hook_footprint(args: &str, stdin: &str) -> (Duration, u64) {
+    let start = Instant::now();
+    let mut child = Command::new(EXE)
+        .raw_arg(args)
+        .stdin(Stdio::piped())
+        .spawn()
+        .expect("failed to start ToastWindow");
+    if let Some(mut pipe) = child.stdin.take() {
+        let _ = pipe.write_all(stdin.as_bytes());
+    }
+    let _ = child.wait();
+    let elapsed = start.elapsed();
+
+    // The exited process's counters stay readable while its handle is open
+    let mut counters = ProcessMemoryCounters {
+        cb: std::mem::size_of::<ProcessMemoryCounters>() as u32,
+        ..Default::default()
+    };
+    let handle = HANDLE(child.as_raw_handle());
+    let ok = unsafe { K32GetProcessMemoryInfo(handle, &mut counters, counters.cb) }.as_bool();
+    (elapsed, if ok { counters.peak_working_set_size as u64 } else { 0 })
+}
+
+fn save_payload(session: &str, prompt_chars: usize) -> String {
+    serde_json::json!({
+        "session_id": session,
+        "hook_event_name": "UserPromptSubmit",
+        "prompt": "x".repeat(prompt_chars),
+    })
+    .to_string()
+}
+
+fn notify_payload(session: &str, message: &str) -> String {
+    serde_json::json!({ "session_id": session, "message": message }).to_string()
+}
+
+fn cleanup(session: &str) {
+    run_hook("--cleanup", &notify_payload(session, ""), 0);
+}
+
+// --- Windows ---
+
+fn find_windows(class: &str) -> Vec<HWND> {
+    let class_wide: Vec<u16> = class.encode_utf16().chain(Some(0)).collect();
+    let mut found = Vec::new();
+    let mut after: Option<HWND> = None;
+    unsafe {
+        while let Ok(hwnd) = FindWindowExW(None, after, PCWSTR(class_wide.as_ptr()), PCWSTR::null()) {
+            if hwnd.is_invalid() {
+                break;
+            }
+            found.push(hwnd);
+            after = Some(hwnd);
+        }
+    }
+    found
+}
+
+/// Process messages for the bench's own windows; a toast activating them
+/// sends them messages and would stall if nobody answered.
+fn pump() {
+    unsafe {
+        let mut msg = MSG::default();
+        while PeekMessageW(&mut msg, None, 0, 0, PM_REMOVE).as_bool() {
+            let _ = TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+    }
+}
+
+fn wait_until(timeout: Duration, mut done: impl FnMut() -> bool) -> bool {
+    let deadline = Instant::now() + timeout;
+    while Instant::now() < deadline {
+        pump();
+        if done() {
+            return true;
+        }
+        std::thread::sleep(Duration::from_millis(1));
+    }
+    false
+}
+
+/// Wait for a visible toast that is not in `before`; returns it and the
+/// time since `start`.
+fn wait_for_toast(before: &[HWND], start: Instant) -> Option<(HWND, Duration)> {
+    let mut toast = None;
+    wait_until(TOAST_TIMEOUT, || {
+        toast = find_windows(TOAST_CLASS)
+            .into_iter()
+            .find(|h| !before.contains(h) && unsafe { IsWindowVisible(*h).as_bool() });
+        toast.is_some()
+    });
+    toast.map(|h| (h, start.elapsed()))
+}
+
+fn dismiss(toast: HWND) {
+    // Right click closes without activation
+    unsafe { let _ = PostMessageW(Some(toast), WM_RBUTTONUP, WPARAM(0), LPARAM(0)); }
+    wait_until(TOAST_TIMEOUT, || !unsafe { IsWindow(Some(toast)).as_bool() });
+}
+
+fn dismiss_all() {
+    // Hidden windows are the host's pre-warmed toasts; leave them alone
+    for toast in find_windows(TOAST_CLASS) {
+        if unsafe { IsWindowVisible(toast).as_bool() } {
+            dismiss(toast);
+        }
+    }
+}
+
+fn stop_host() {
+    for host in find_windows(HOST_CLASS) {
+        unsafe { let _ = PostMessageW(Some(host), WM_CLOSE, WPARAM(0), LPARAM(0)); }
+    }
+    wait_until(Duration::from_secs(2), || find_windows(HOST_CLASS).is_empty());
+}
+
+unsafe extern "system" fn target_wnd_proc(hwnd: HWND, msg: u32, wparam: WPARAM, lparam: LPARAM) -> LRESULT {
+    DefWindowProcW(hwnd, msg, wparam, lparam)
+}
+
+fn create_target_window(title: &str) -> HWND {
+    unsafe {
+        let instance = GetModuleHandleW(None).unwrap_or_default();
+        let class_wide: Vec<u16> = TARGET_CLASS.encode_utf16().chain(Some(0)).collect();
+        let title_wide: Vec<u16> = title.encode_utf16().chain(Some(0)).collect();
+        let wc = WNDCLASSW {
+            lpfnWndProc: Some(target_wnd_proc),
+            hInstance: instance.into(),
+            lpszClassName: PCWSTR(class_wide.as_ptr()),
+            ..Default::default()
+        };
+        let _ = RegisterClassW(&wc);
+        CreateWindowExW(
+            WINDOW_EX_STYLE(0),
+            PCWSTR(class_wide.as_ptr()),
+            PCWSTR(title_wide.as_ptr()),
+            WS_OVERLAPPEDWINDOW | WS_VISIBLE,
+            100, 100, 400, 200,
+            None, None, Some(instance.into()), None,
+        )
+        .unwrap_or_default()
+    }
+}
+
+/// Make `hwnd` the foreground window from the bench process.
+fn bring_to_front(hwnd: HWND) -> bool {
+    unsafe {
+        keybd_event(VK_MENU.0 as u8, 0, KEYEVENTF_EXTENDEDKEY, 0);
+        keybd_event(VK_MENU.0 as u8, 0, KEYEVENTF_EXTENDEDKEY | KEYEVENTF_KEYUP, 0);
+        let _ = SetForegroundWindow(hwnd);
+    }
+    wait_until(Duration::from_millis(500), || unsafe { GetForegroundWindow() } == hwnd)
+}
+
+/// Click the toast body (left of the close button), which activates the
+/// saved window. Returns the time until `target` is in the foreground.
+fn click_and_wait_for(toast: HWND, target: HWND) -> Option<Duration> {
+    let start = Instant::now();
+    let lparam = LPARAM(((40 << 16) | 60) as isize);
+    unsafe { let _ = PostMessageW(Some(toast), WM_LBUTTONUP, WPARAM(0), lparam); }
+    let activated = wait_until(ACTIVATION_TIMEOUT, || unsafe { GetForegroundWindow() } == target);
+    wait_until(TOAST_TIMEOUT, || !unsafe { IsWindow(Some(toast)).as_bool() });
+    activated.then(|| start.elapsed())
+}
+
+// --- Scenarios ---
+
+fn bench_save(report: &mut Report, options: &Options) {
+    for &size in PROMPT_SIZES {
+        for (label, args) in [("--save", "--save"), ("--save --defer", "--save --defer")] {
+            let mut samples = Vec::new();
+            for i in 0..options.iterations {
+                let session = format!("bench-save-{}-{}", std::process::id(), i);
+                samples.push(run_hook(args, &save_payload(&session, size), options.depth));
+                cleanup(&session);
+            }
+            report.add(&format!("{} return ({} chars)", label, size), samples);
+        }
+    }
+}
+
+fn bench_footprint(report: &mut Report, options: &Options) {
+    let scenarios: [(&str, &str, bool); 5] = [
+        ("startup (--cleanup, no session)", "--cleanup", false),
+        ("--save", "--save", false),
+        ("--save --defer", "--save --defer", false),
+        ("--notify", "--notify", true),
+        ("--input", "--input", true),
+    ];
+    for (label, args, shows_toast) in scenarios {
+        let mut times = Vec::new();
+        let mut peaks = Vec::new();
+        for i in 0..options.iterations {
+            let session = format!("bench-footprint-{}-{}", std::process::id(), i);
+            let payload = match args {
+                "--cleanup" => "{}".to_string(),
+                "--save" | "--save --defer" => save_payload(&session, 100),
+                _ => notify_payload(&session, "Bench footprint"),
+            };
+            let (elapsed, peak) = run_hook_footprint(args, &payload);
+            times.push(elapsed);
+            if peak > 0 {
+                peaks.push(peak);
+            }
+            if shows_toast {
+                let _ = wait_for_toast(&[], Instant::now());
+                dismiss_all();
+            }
+            cleanup(&session);
+        }
+        if args == "--cleanup" {
+            report.add(label, times);
+        }
+        report.add_memory(label, peaks);
+    }
+}
+
+fn bench_toasts(report: &mut Report, options: &Options) {
+    let session = format!("bench-toast-{}", std::process::id());
+    run_hook("--save", &save_payload(&session, 100), options.depth);
+
+    for (label, args, payload) in [
+        ("--notify", "--notify", notify_payload(&session, "")),
+        ("--input", "--input", notify_payload(&session, "Bench input")),
+    ] {
+        stop_host();
+        let mut returns = Vec::new();
+        let mut paints = Vec::new();
+        for i in 0..=options.iterations {
+            dismiss_all();
+            let before = find_windows(TOAST_CLASS);
+            let start = Instant::now();
+            let elapsed = run_hook(args, &payload, options.depth);
+            let Some((toast, paint)) = wait_for_toast(&before, start) else {
+                println!("{}: no toast appeared", label);
+                continue;
+            };
+            dismiss(toast);
+            if i == 0 {
+                // First request starts the host
+                report.add(&format!("{} first paint (cold host)", label), vec![paint]);
+            } else {
+                returns.push(elapsed);
+                paints.push(paint);
+            }
+        }
+        report.add(&format!("{} return", label), returns);
+        report.add(&format!("{} first paint (warm host)", label), paints);
+    }
+
+    let mut paints = Vec::new();
+    for _ in 0..options.iterations {
+        dismiss_all();
+        let before = find_windows(TOAST_CLASS);
+        let start = Instant::now();
+        let mut child = Command::new(EXE)
+            .raw_arg(format!("--notify-show --session \"{}\"", session))
+            .spawn()
+            .expect("failed to start ToastWindow");
+        if let Some((toast, paint)) = wait_for_toast(&before, start) {
+            paints.push(paint);
+            dismiss(toast);
+        }
+        let _ = child.wait();
+    }
+    report.add("--notify-show first paint", paints);
+
+    cleanup(&session);
+}
+
+/// Save with `target` in the foreground, move focus elsewhere, then click
+/// the toast and time the switch back.
+fn bench_activation(report: &mut Report, options: &Options, name: &str, target: HWND, other: HWND) {
+    let session = format!("bench-activate-{}", std::process::id());
+    let mut samples = Vec::new();
+    for _ in 0..options.iterations {
+        dismiss_all();
+        if !bring_to_front(target) {
+            println!("{}: could not focus the target window, skipping", name);
+            break;
+        }
+        run_hook("--save", &save_payload(&session, 100), options.depth);
+        if !bring_to_front(other) {
+            println!("{}: could not focus the other window, skipping", name);
+            break;
+        }
+
+        let before = find_windows(TOAST_CLASS);
+        run_hook("--notify", &notify_payload(&session, ""), options.depth);
+        let Some((toast, _)) = wait_for_toast(&before, Instant::now()) else { continue };
+        match click_and_wait_for(toast, target) {
+            Some(elapsed) => samples.push(elapsed),
+            None => println!("{}: activation timed out", name),
+        }
+    }
+    report.add(name, samples);
+    cleanup(&session);
+}
+
+/// Open a Windows Terminal window with `tabs` tabs and return it.
+fn open_wt(tabs: usize) -> Option<HWND> {
+    let before = find_windows(WT_CLASS);
+    let mut args = String::from("-w new new-tab --title bench-1 cmd /k");
+    for i in 2..=tabs {
+        args.push_str(&format!(" ; new-tab --title bench-{} cmd /k", i));
+    }
+    Command::new("wt.exe").raw_arg(args).spawn().ok()?;
+
+    let mut wt = None;
+    wait_until(Duration::from_secs(10), || {
+        wt = find_windows(WT_CLASS).into_iter().find(|h| !before.contains(h));
+        wt.is_some()
+    });
+    // Give the tab row time to populate its automation tree
+    std::thread::sleep(Duration::from_secs(2));
+    wt
+}
+
+fn bench_wt(report: &mut Report, options: &Options, other: HWND) {
+    let Some(wt) = open_wt(options.wt_tabs) else {
+        println!("Windows Terminal not available, skipping WT scenarios");
+        return;
+    };
+
+    let session = format!("bench-wt-{}", std::process::id());
+    let mut saves = Vec::new();
+    for _ in 0..options.iterations {
+        if !bring_to_front(wt) {
+            println!("WT: could not focus the terminal, skipping");
+            break;
+        }
+        saves.push(run_hook("--save", &save_payload(&session, 100), options.depth));
+    }
+    report.add(&format!("--save return (WT, {} tabs)", options.wt_tabs), saves);
+    cleanup(&session);
+
+    bench_activation(report, options, &format!("activation (WT, {} tabs)", options.wt_tabs), wt, other);
+
+    unsafe { let _ = PostMessageW(Some(wt), WM_CLOSE, WPARAM(0), LPARAM(0)); }
+}
+
+fn main() {
+    let options = parse_options();
+    println!("Benchmarking {}", EXE);
+    println!("iterations: {}, shell depth: {}, WT tabs: {}", options.iterations, options.depth, options.wt_tabs);
+
+    let mut report = Report::default();
+    bench_save(&mut report, &options);
+    bench_toasts(&mut report, &options);
+    bench_footprint(&mut report, &options);
+
+    let target = create_target_window("Toast bench target");
+    let other = create_target_window("Toast bench other");
+    bench_activation(&mut report, &options, "activation (regular window)", target, other);
+    if options.wt_tabs > 0 {
+        bench_wt(&mut report, &options, other);
+    }
+
+    dismiss_all();
+    stop_host();
+    unsafe {
+        let _ = DestroyWindow(target);
+        let _ = DestroyWindow(other);
+    }
+
+    report.print();
+}
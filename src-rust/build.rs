@@ -0,0 +1,35 @@
+//! Build script: delay-load the DLLs only the GUI paths use.
+//!
+//! With MSVC these imports are bound on first call instead of at process
+//! start, so hook invocations that never draw, play sound or touch the
+//! shell skip mapping and initializing them; the host and toast paths load
+//! them as needed. What a mode saves depends on what it calls:
+//!
+//! - `--notify`, `--input` and `--cleanup` skip all of them, COM included.
+//! - `--save` initializes COM for the Windows Terminal tab lookup, so
+//!   ole32/oleaut32 still load there; the rest stay unloaded.
+//!
+//! gdi32 is not listed: user32 imports it, so it is mapped at start up anyway.
+//! Names the binary does not import are ignored by the linker (LNK4199).
+
+const DELAY_LOAD: &[&str] = &[
+    "shell32.dll",
+    "dwmapi.dll",
+    "winmm.dll",
+    "ole32.dll",
+    "oleaut32.dll",
+    "shcore.dll",
+    "api-ms-win-shcore-scaling-l1-1-1.dll",
+];
+
+fn main() {
+    println!("cargo:rerun-if-changed=build.rs");
+    if std::env::var("CARGO_CFG_TARGET_ENV").as_deref() != Ok("msvc") {
+        return;
+    }
+    for dll in DELAY_LOAD {
+        println!("cargo:rustc-link-arg-bins=/DELAYLOAD:{}", dll);
+    }
+    println!("cargo:rustc-link-arg-bins=delayimp.lib");
+    println!("cargo:rustc-link-arg-bins=/IGNORE:4199");
+}
@@ -1,10 +1,14 @@
 //! Window activation with focus-stealing workaround.
 //!
-//! Implements the ALT key trick and full 12-step activation sequence
-//! for both regular windows and Windows Terminal tabs.
+//! Tries the cheapest activation first and escalates through the ALT key
+//! trick to the full 12-step sequence only when the foreground did not
+//! change, for both regular windows and Windows Terminal tabs.
+
+use std::time::{Duration, Instant};
 
 use windows::Win32::Foundation::*;
 use windows::Win32::System::Threading::{AttachThreadInput, GetCurrentThreadId};
+use windows::Win32::UI::Accessibility::{SetWinEventHook, UnhookWinEvent, HWINEVENTHOOK};
 use windows::Win32::UI::Input::KeyboardAndMouse::*;
 use windows::Win32::UI::WindowsAndMessaging::*;
 
@@ -17,6 +21,8 @@ pub fn activate_window(
     wt_hwnd: HWND,
     wt_runtime_id: &str,
 ) {
+    let _span = crate::log::span("activation");
+    crate::etw_event!("activate begin: target={:?} wt={:?}", target, wt_hwnd);
     if !wt_hwnd.is_invalid()
         && wt_hwnd != HWND::default()
         && !wt_runtime_id.is_empty()
@@ -32,6 +38,7 @@ pub fn activate_window(
     } else {
         crate::debug_log!("No valid target window to activate");
     }
+    crate::etw_event!("activate end: foreground={:?}", unsafe { GetForegroundWindow() });
 }
 
 fn switch_to_wt_tab(wt_hwnd: HWND, runtime_id: &str) {
@@ -40,6 +47,11 @@ fn switch_to_wt_tab(wt_hwnd: HWND, runtime_id: &str) {
         return;
     }
 
+    // Switch to the correct tab via UI Automation on the worker thread,
+    // while this thread brings the window forward. Nothing waits for it:
+    // the toast is dismissed as soon as the window is in front.
+    uiautomation::select_tab_async(wt_hwnd, runtime_id);
+
     // Restore if minimized
     if unsafe { IsIconic(wt_hwnd).as_bool() } {
         unsafe { let _ = ShowWindow(wt_hwnd, SW_RESTORE); }
@@ -47,62 +59,138 @@ fn switch_to_wt_tab(wt_hwnd: HWND, runtime_id: &str) {
 
     // Bring WT window to foreground
     activate_hwnd(wt_hwnd);
-
-    // Switch to the correct tab via UI Automation
-    if uiautomation::select_tab_by_runtime_id(wt_hwnd, runtime_id) {
-        crate::debug_log!("WT tab selected successfully");
-    } else {
-        crate::debug_log!("WT tab not found (may have been closed)");
-    }
 }
 
-/// Full 12-step activation sequence (SPEC 7.2).
+/// How long each activation attempt waits for the foreground change.
+const FOREGROUND_WAIT_MS: u64 = 50;
+
+/// Private message used only as a PeekMessage filter, so waiting runs
+/// WinEvent callbacks without pulling the toast's own messages.
+const WM_FOREGROUND_WAIT: u32 = WM_APP + 0x3F0;
+
+/// Bring `target` to the foreground, escalating only when needed.
+/// 1. Plain SetForegroundWindow (usually enough: the click gave us the right)
+/// 2. ALT key trick, then SetForegroundWindow again
+/// 3. Full 12-step sequence (SPEC 7.2)
 fn activate_hwnd(target: HWND) {
     unsafe {
-        // Step 1: Allow any process to set foreground
+        // Allow any process to set foreground
         let _ = AllowSetForegroundWindow(ASFW_ANY);
 
-        // Step 2: Restore if minimized
+        // Restore if minimized
         if IsIconic(target).as_bool() {
             let _ = ShowWindow(target, SW_RESTORE);
         }
 
-        // Step 3: ALT key trick
+        if SetForegroundWindow(target).as_bool() && wait_for_foreground(target) {
+            crate::debug_log!("Activated with SetForegroundWindow");
+            return;
+        }
+
         try_alt_key_trick();
+        if SetForegroundWindow(target).as_bool() && wait_for_foreground(target) {
+            crate::debug_log!("Activated after ALT key trick");
+            return;
+        }
 
-        // Steps 4-6: Get thread IDs
-        let fg_hwnd = GetForegroundWindow();
-        let fg_thread = GetWindowThreadProcessId(fg_hwnd, None);
-        let cur_thread = GetCurrentThreadId();
-        let target_thread = GetWindowThreadProcessId(target, None);
-
-        // Steps 7-8: Attach thread input
-        let _ = AttachThreadInput(cur_thread, fg_thread, true);
-        let _ = AttachThreadInput(cur_thread, target_thread, true);
-
-        // Step 9: Set window position to top
-        let _ = SetWindowPos(
-            target,
-            Some(HWND_TOP),
-            0, 0, 0, 0,
-            SWP_NOMOVE | SWP_NOSIZE | SWP_SHOWWINDOW,
-        );
+        crate::debug_log!("Escalating to full activation sequence");
+        force_foreground(target);
+        wait_for_foreground(target);
+    }
+}
 
-        // Step 10: Bring to top
-        let _ = BringWindowToTop(target);
+/// Steps 4-12 of the activation sequence (SPEC 7.2).
+unsafe fn force_foreground(target: HWND) {
+    // Steps 4-6: Get thread IDs
+    let fg_hwnd = GetForegroundWindow();
+    let fg_thread = GetWindowThreadProcessId(fg_hwnd, None);
+    let cur_thread = GetCurrentThreadId();
+    let target_thread = GetWindowThreadProcessId(target, None);
+
+    // Steps 7-8: Attach thread input
+    let _ = AttachThreadInput(cur_thread, fg_thread, true);
+    let _ = AttachThreadInput(cur_thread, target_thread, true);
+
+    // Step 9: Set window position to top
+    let _ = SetWindowPos(
+        target,
+        Some(HWND_TOP),
+        0, 0, 0, 0,
+        SWP_NOMOVE | SWP_NOSIZE | SWP_SHOWWINDOW,
+    );
+
+    // Step 10: Bring to top
+    let _ = BringWindowToTop(target);
+
+    // Step 11: SwitchToThisWindow (undocumented but effective)
+    SwitchToThisWindow(target, true);
+
+    // Step 12: Set foreground
+    let _ = SetForegroundWindow(target);
+
+    // Detach thread input
+    let _ = AttachThreadInput(cur_thread, target_thread, false);
+    let _ = AttachThreadInput(cur_thread, fg_thread, false);
+}
+
+/// Wait up to FOREGROUND_WAIT_MS for `target` to become the foreground
+/// window. An EVENT_SYSTEM_FOREGROUND hook wakes the wait as soon as the
+/// switch happens instead of sleeping for a fixed time.
+fn wait_for_foreground(target: HWND) -> bool {
+    let is_foreground = || unsafe { GetForegroundWindow() } == target;
+    if is_foreground() {
+        return true;
+    }
 
-        // Step 11: SwitchToThisWindow (undocumented but effective)
-        SwitchToThisWindow(target, true);
+    unsafe {
+        let hook = SetWinEventHook(
+            EVENT_SYSTEM_FOREGROUND,
+            EVENT_SYSTEM_FOREGROUND,
+            None,
+            Some(foreground_event_proc),
+            0,
+            0,
+            WINEVENT_OUTOFCONTEXT,
+        );
 
-        // Step 12: Set foreground
-        let _ = SetForegroundWindow(target);
+        let deadline = Instant::now() + Duration::from_millis(FOREGROUND_WAIT_MS);
+        let mut activated = is_foreground();
+        while !activated {
+            let remaining = deadline.saturating_duration_since(Instant::now());
+            if remaining.is_zero() {
+                break;
+            }
+            if hook.is_invalid() {
+                // No hook: fall back to short sleeps
+                std::thread::sleep(remaining.min(Duration::from_millis(5)));
+            } else {
+                MsgWaitForMultipleObjects(None, false, remaining.as_millis() as u32, QS_ALLINPUT);
+                // Delivers the queued WinEvent callback; nothing matches the filter
+                let mut msg = MSG::default();
+                let _ = PeekMessageW(&mut msg, None, WM_FOREGROUND_WAIT, WM_FOREGROUND_WAIT, PM_NOREMOVE);
+            }
+            activated = is_foreground();
+        }
 
-        // Detach thread input
-        let _ = AttachThreadInput(cur_thread, target_thread, false);
-        let _ = AttachThreadInput(cur_thread, fg_thread, false);
+        if !hook.is_invalid() {
+            let _ = UnhookWinEvent(hook);
+        }
+        activated
     }
 }
 
+/// Only used to wake `wait_for_foreground`; the check is done by the caller.
+unsafe extern "system" fn foreground_event_proc(
+    _hook: HWINEVENTHOOK,
+    _event: u32,
+    _hwnd: HWND,
+    _id_object: i32,
+    _id_child: i32,
+    _event_thread: u32,
+    _event_time: u32,
+) {
+}
+
 /// Simulate ALT key press/release to trick Windows into allowing
 /// foreground window changes (SPEC 7.1).
 fn try_alt_key_trick() {
@@ -120,5 +208,4 @@ fn try_alt_key_trick() {
             0,
         );
     }
-    std::thread::sleep(std::time::Duration::from_millis(50));
 }
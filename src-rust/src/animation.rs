@@ -0,0 +1,82 @@
+//! Process-wide animation clock.
+//!
+//! One thread paces every toast animation in the process. Each frame it
+//! posts WM_ANIMATION_FRAME to every animating toast and then waits for the
+//! next DWM composition pass (DwmFlush), so frames follow the monitor's
+//! refresh rate. Toasts derive fade and slide progress from elapsed
+//! `Instant` time (QPC), so a late frame changes smoothness, not duration.
+
+use std::sync::{Condvar, Mutex};
+use std::time::Duration;
+
+use windows::Win32::Foundation::*;
+use windows::Win32::Graphics::Dwm::DwmFlush;
+use windows::Win32::UI::WindowsAndMessaging::*;
+
+/// Posted to an animating toast once per frame.
+pub const WM_ANIMATION_FRAME: u32 = WM_USER + 103;
+
+/// Frame interval used when DWM composition is unavailable.
+const FALLBACK_FRAME: Duration = Duration::from_millis(16);
+
+struct Clock {
+    /// Animating toast windows (raw HWND values; HWND is not Send).
+    windows: Vec<isize>,
+    running: bool,
+}
+
+static CLOCK: Mutex<Clock> = Mutex::new(Clock { windows: Vec::new(), running: false });
+static WAKE: Condvar = Condvar::new();
+
+/// Deliver frames to `hwnd` until `stop` is called for it.
+pub fn start(hwnd: HWND) {
+    let mut clock = CLOCK.lock().unwrap_or_else(|e| e.into_inner());
+    let raw = hwnd.0 as isize;
+    if !clock.windows.contains(&raw) {
+        clock.windows.push(raw);
+    }
+    if !clock.running {
+        let spawned = std::thread::Builder::new()
+            .name("animation".to_string())
+            .spawn(run_clock);
+        clock.running = spawned.is_ok();
+        if !clock.running {
+            crate::debug_log!("Failed to start animation clock");
+        }
+    }
+    WAKE.notify_one();
+}
+
+/// Stop delivering frames to `hwnd`.
+pub fn stop(hwnd: HWND) {
+    let mut clock = CLOCK.lock().unwrap_or_else(|e| e.into_inner());
+    let raw = hwnd.0 as isize;
+    clock.windows.retain(|&w| w != raw);
+}
+
+fn run_clock() {
+    loop {
+        let targets = {
+            let mut clock = CLOCK.lock().unwrap_or_else(|e| e.into_inner());
+            while clock.windows.is_empty() {
+                clock = WAKE.wait(clock).unwrap_or_else(|e| e.into_inner());
+            }
+            clock.windows.clone()
+        };
+
+        for raw in targets {
+            let hwnd = HWND(raw as *mut _);
+            let posted = unsafe {
+                PostMessageW(Some(hwnd), WM_ANIMATION_FRAME, WPARAM(0), LPARAM(0))
+            };
+            if posted.is_err() {
+                // Window is gone without calling stop
+                stop(hwnd);
+            }
+        }
+
+        if unsafe { DwmFlush() }.is_err() {
+            std::thread::sleep(FALLBACK_FRAME);
+        }
+    }
+}
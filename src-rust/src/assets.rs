@@ -1,6 +1,18 @@
 //! Asset discovery, font loading, icon extraction, and sound playback.
+//!
+//! With the `embed-assets` feature the sound, font and default icon are
+//! compiled into the executable and loaded from memory; nothing is looked
+//! up next to the exe.
+
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex};
+#[cfg(not(feature = "embed-assets"))]
+use std::sync::OnceLock;
+use std::time::{Duration, Instant};
 
 use windows::core::PCWSTR;
+#[cfg(feature = "embed-assets")]
+use windows::Win32::Foundation::HANDLE;
 use windows::Win32::Graphics::Gdi::*;
 use windows::Win32::Storage::FileSystem::*;
 use windows::Win32::UI::Shell::ExtractIconExW;
@@ -8,6 +20,42 @@ use windows::Win32::UI::WindowsAndMessaging::*;
 
 const FR_PRIVATE: u32 = 0x10;
 
+/// `default_icon_path` value meaning "the icon compiled into the binary".
+#[cfg(feature = "embed-assets")]
+const EMBEDDED_ICON: &str = "<embedded>";
+
+#[cfg(feature = "embed-assets")]
+mod embedded {
+    pub const SOUND: &[u8] = include_bytes!("../../assets/sound/notification.wav");
+    pub const FONT: &[u8] = include_bytes!("../../assets/font/JetBrainsMono-ExtraBold.ttf");
+    pub const ICON: &[u8] = include_bytes!("../../assets/img/claude.ico");
+    /// GDI family name from the font's name table (name ID 1).
+    pub const FONT_FAMILY: &str = "JetBrains Mono ExtraBold";
+}
+
+/// Icons kept for the lifetime of the process, keyed by source path and size.
+/// Stored as raw handle values because HICON is not Send.
+static ICON_CACHE: Mutex<Option<HashMap<String, isize>>> = Mutex::new(None);
+
+/// Caller-exe icons rendered to bitmaps, keyed like the on-disk cache entries.
+static BITMAP_CACHE: Mutex<Option<HashMap<String, Arc<IconBitmap>>>> = Mutex::new(None);
+
+/// On-disk icon bitmap file: magic | size u32 | key len u32 | key | pixels.
+const ICON_FILE_MAGIC: &[u8; 4] = b"CCIC";
+
+/// Icon files kept on disk across all exes and sizes; writing a new one
+/// removes the least recently written beyond this.
+const MAX_ICON_FILES: usize = 64;
+
+/// Notification WAV read once per process for SND_MEMORY playback. Never
+/// freed: asynchronous playback keeps reading it after PlaySoundW returns.
+#[cfg(not(feature = "embed-assets"))]
+static SOUND_DATA: OnceLock<Vec<u8>> = OnceLock::new();
+
+/// Start time of the last sound, so a burst of toasts plays it only once.
+static LAST_SOUND: Mutex<Option<Instant>> = Mutex::new(None);
+const SOUND_COALESCE: Duration = Duration::from_millis(300);
+
 /// Find the first file matching a pattern in a directory.
 /// e.g., find_first_file("C:\\dir", "*.wav")
 pub fn find_first_file(dir: &str, pattern: &str) -> Option<String> {
@@ -46,6 +94,7 @@ pub struct Assets {
     pub default_icon_path: Option<String>,
 }
 
+#[cfg_attr(feature = "embed-assets", allow(dead_code))]
 pub fn discover_assets() -> Assets {
     let dir = exe_dir();
     let sound_dir = format!("{}\\assets\\sound", dir);
@@ -60,7 +109,97 @@ pub fn discover_assets() -> Assets {
     }
 }
 
+/// How the custom font was registered, so `release` can undo it.
+enum RegisteredFont {
+    None,
+    #[cfg(not(feature = "embed-assets"))]
+    File(String),
+    #[cfg(feature = "embed-assets")]
+    Memory(isize),
+}
+
+/// Assets discovered and registered once per toast process.
+pub struct LoadedAssets {
+    font: RegisteredFont,
+    pub default_icon_path: String,
+    pub font_family: String,
+}
+
+/// Register the embedded font and point the default icon at the embedded copy.
+/// Call `release` when the process no longer shows toasts.
+#[cfg(feature = "embed-assets")]
+pub fn load_assets() -> LoadedAssets {
+    let _span = crate::log::span("asset load");
+    let mut num_fonts: u32 = 0;
+    let handle = unsafe {
+        AddFontMemResourceEx(
+            embedded::FONT.as_ptr() as *const _,
+            embedded::FONT.len() as u32,
+            None,
+            &mut num_fonts,
+        )
+    };
+    let (font, font_family) = if !handle.is_invalid() && num_fonts > 0 {
+        (RegisteredFont::Memory(handle.0 as isize), embedded::FONT_FAMILY.to_string())
+    } else {
+        (RegisteredFont::None, "Segoe UI".to_string())
+    };
+    crate::debug_log!("Embedded assets, font family: {}", font_family);
+
+    LoadedAssets {
+        font,
+        default_icon_path: EMBEDDED_ICON.to_string(),
+        font_family,
+    }
+}
+
+/// Discover assets, register the custom font and preload the sound.
+/// Call `release` when the process no longer shows toasts.
+#[cfg(not(feature = "embed-assets"))]
+pub fn load_assets() -> LoadedAssets {
+    let _span = crate::log::span("asset load");
+    let discovered = discover_assets();
+    crate::debug_log!("Sound: {:?}, Font: {:?}, Icon: {:?}",
+        discovered.sound_file, discovered.font_file, discovered.default_icon_path);
+
+    let loaded_font = discovered.font_file.and_then(|font_path| {
+        load_font(&font_path).map(|family| (font_path, family))
+    });
+    let (font, font_family) = match loaded_font {
+        Some((font_path, family)) => (RegisteredFont::File(font_path), family),
+        None => (RegisteredFont::None, "Segoe UI".to_string()),
+    };
+    crate::debug_log!("Font family: {}", font_family);
+
+    if let Some(ref wav_path) = discovered.sound_file {
+        preload_sound(wav_path);
+    }
+
+    LoadedAssets {
+        font,
+        default_icon_path: discovered.default_icon_path.unwrap_or_default(),
+        font_family,
+    }
+}
+
+impl LoadedAssets {
+    /// Unregister the custom font loaded by `load_assets` and free cached icons.
+    pub fn release(&self) {
+        match self.font {
+            RegisteredFont::None => {}
+            #[cfg(not(feature = "embed-assets"))]
+            RegisteredFont::File(ref font_path) => unload_font(font_path),
+            #[cfg(feature = "embed-assets")]
+            RegisteredFont::Memory(raw) => unsafe {
+                let _ = RemoveFontMemResourceEx(HANDLE(raw as *mut _));
+            },
+        }
+        release_icons();
+    }
+}
+
 /// Load a custom font file as a private font. Returns the derived font family name.
+#[cfg_attr(feature = "embed-assets", allow(dead_code))]
 pub fn load_font(font_path: &str) -> Option<String> {
     let path_wide = crate::util::encode_wide(font_path);
     let result = unsafe {
@@ -74,6 +213,7 @@ pub fn load_font(font_path: &str) -> Option<String> {
 }
 
 /// Remove a previously loaded private font.
+#[cfg_attr(feature = "embed-assets", allow(dead_code))]
 pub fn unload_font(font_path: &str) {
     let path_wide = crate::util::encode_wide(font_path);
     unsafe {
@@ -118,8 +258,316 @@ fn derive_font_family(path: &str) -> String {
     result
 }
 
+fn cached_icon(key: String, load: impl FnOnce() -> HICON) -> HICON {
+    let mut guard = ICON_CACHE.lock().unwrap_or_else(|e| e.into_inner());
+    let cache = guard.get_or_insert_with(HashMap::new);
+    if let Some(&raw) = cache.get(&key) {
+        return HICON(raw as *mut _);
+    }
+    let icon = load();
+    if !icon.is_invalid() {
+        cache.insert(key, icon.0 as isize);
+    }
+    icon
+}
+
+fn release_icons() {
+    let mut guard = ICON_CACHE.lock().unwrap_or_else(|e| e.into_inner());
+    if let Some(cache) = guard.take() {
+        for raw in cache.into_values() {
+            unsafe { let _ = DestroyIcon(HICON(raw as *mut _)); }
+        }
+    }
+    BITMAP_CACHE.lock().unwrap_or_else(|e| e.into_inner()).take();
+}
+
+/// A `size` x `size` icon as top-down premultiplied BGRA pixels.
+pub struct IconBitmap {
+    pub size: i32,
+    pub pixels: Vec<u32>,
+}
+
+/// Icon of the caller exe as a bitmap pre-scaled to `size`. Looked up in
+/// memory, then in the persistent cache under %LOCALAPPDATA%, and only
+/// extracted from the exe when the exe's path, mtime or size is new.
+/// Writing a new build's entry drops the old build's; the directory is
+/// capped at MAX_ICON_FILES.
+pub fn exe_icon(exe_path: &str, size: i32) -> Option<Arc<IconBitmap>> {
+    if exe_path.is_empty() {
+        return None;
+    }
+
+    // mtime and length identify the exe build; unreadable metadata just
+    // skips the disk cache
+    let stamp = std::fs::metadata(exe_path).ok().and_then(|m| {
+        let mtime = m.modified().ok()?.duration_since(std::time::UNIX_EPOCH).ok()?;
+        Some((mtime.as_nanos(), m.len()))
+    });
+    let key = match stamp {
+        Some((mtime, len)) => format!("{}|{}|{}|{}", size, exe_path.to_lowercase(), mtime, len),
+        None => format!("{}|{}", size, exe_path.to_lowercase()),
+    };
+
+    let mut guard = BITMAP_CACHE.lock().unwrap_or_else(|e| e.into_inner());
+    let cache = guard.get_or_insert_with(HashMap::new);
+    if let Some(bitmap) = cache.get(&key) {
+        return Some(bitmap.clone());
+    }
+
+    let file = stamp.map(|(mtime, len)| icon_cache_dir().join(icon_file_name(exe_path, mtime, len, size)));
+    let bitmap = match file.as_ref().and_then(|f| read_icon_file(f, &key, size)) {
+        Some(bitmap) => bitmap,
+        None => {
+            let icon = extract_icon(exe_path);
+            if icon.is_invalid() {
+                return None;
+            }
+            let pixels = unsafe { rasterize_icon(icon, size) };
+            unsafe { let _ = DestroyIcon(icon); }
+            let bitmap = IconBitmap { size, pixels: pixels? };
+            if let Some(ref f) = file {
+                write_icon_file(f, &key, &bitmap);
+            }
+            bitmap
+        }
+    };
+
+    let bitmap = Arc::new(bitmap);
+    cache.insert(key, bitmap.clone());
+    Some(bitmap)
+}
+
+fn icon_cache_dir() -> std::path::PathBuf {
+    let base = std::env::var_os("LOCALAPPDATA")
+        .map(std::path::PathBuf::from)
+        .unwrap_or_else(std::env::temp_dir);
+    base.join("claude-code-notify").join("icons")
+}
+
+/// "<exe hash>-<build hash>-<size>.bgra": every DPI size of one exe build
+/// shares the first two parts, so entries of an older build can be told
+/// apart by name alone.
+fn icon_file_name(exe_path: &str, mtime: u128, len: u64, size: i32) -> String {
+    format!(
+        "{:016x}-{:016x}-{}.bgra",
+        fnv1a(exe_path.to_lowercase().as_bytes()),
+        fnv1a(format!("{}|{}", mtime, len).as_bytes()),
+        size
+    )
+}
+
+/// 64-bit FNV-1a, stable across builds (unlike std's hasher).
+fn fnv1a(bytes: &[u8]) -> u64 {
+    let mut hash: u64 = 0xcbf2_9ce4_8422_2325;
+    for &b in bytes {
+        hash ^= b as u64;
+        hash = hash.wrapping_mul(0x0000_0100_0000_01b3);
+    }
+    hash
+}
+
+fn read_icon_file(path: &std::path::Path, key: &str, size: i32) -> Option<IconBitmap> {
+    let data = std::fs::read(path).ok()?;
+    let read_u32 = |pos: usize| -> Option<u32> { Some(u32::from_le_bytes(data.get(pos..pos + 4)?.try_into().ok()?)) };
+
+    if data.get(0..4)? != ICON_FILE_MAGIC || read_u32(4)? != size as u32 {
+        return None;
+    }
+    let key_len = read_u32(8)? as usize;
+    // The file name is a hash; the stored key rules out collisions
+    if data.get(12..12 + key_len)? != key.as_bytes() {
+        return None;
+    }
+    let pixel_bytes = data.get(12 + key_len..)?;
+    if pixel_bytes.len() != (size * size * 4) as usize {
+        return None;
+    }
+    let pixels = pixel_bytes
+        .chunks_exact(4)
+        .map(|c| u32::from_le_bytes([c[0], c[1], c[2], c[3]]))
+        .collect();
+    Some(IconBitmap { size, pixels })
+}
+
+/// Best effort: a failed write only costs a re-extraction next time.
+fn write_icon_file(path: &std::path::Path, key: &str, bitmap: &IconBitmap) {
+    let mut data = Vec::with_capacity(12 + key.len() + bitmap.pixels.len() * 4);
+    data.extend_from_slice(ICON_FILE_MAGIC);
+    data.extend_from_slice(&(bitmap.size as u32).to_le_bytes());
+    data.extend_from_slice(&(key.len() as u32).to_le_bytes());
+    data.extend_from_slice(key.as_bytes());
+    for px in &bitmap.pixels {
+        data.extend_from_slice(&px.to_le_bytes());
+    }
+
+    let Some(dir) = path.parent() else { return };
+    if std::fs::create_dir_all(dir).is_err() {
+        return;
+    }
+    let tmp = path.with_extension(format!("{}.tmp", std::process::id()));
+    if std::fs::write(&tmp, &data).is_err() {
+        return;
+    }
+    if std::fs::rename(&tmp, path).is_err() {
+        let _ = std::fs::remove_file(&tmp);
+        return;
+    }
+    prune_icon_files(dir, path);
+}
+
+/// Remove the entries a new icon file supersedes: the other builds of the
+/// same exe (any size), then the least recently written files beyond
+/// MAX_ICON_FILES. Files of other sizes of the same build are kept.
+fn prune_icon_files(dir: &std::path::Path, written: &std::path::Path) {
+    let Some(name) = written.file_name().and_then(|n| n.to_str()) else { return };
+    let (Some(exe), Some(build)) = (name.get(..16), name.get(..33)) else { return };
+    let Ok(entries) = std::fs::read_dir(dir) else { return };
+
+    let mut kept = Vec::new();
+    for entry in entries.flatten() {
+        let path = entry.path();
+        // Temp files may still be written by another process
+        if path == written || path.extension().and_then(|e| e.to_str()) != Some("bgra") {
+            continue;
+        }
+        let file_name = entry.file_name();
+        let file_name = file_name.to_string_lossy();
+        if file_name.starts_with(exe) && !file_name.starts_with(build) {
+            let _ = std::fs::remove_file(&path);
+            continue;
+        }
+        let written_at = entry.metadata().and_then(|m| m.modified()).unwrap_or(std::time::UNIX_EPOCH);
+        kept.push((written_at, path));
+    }
+
+    // The new file counts towards the cap
+    if kept.len() >= MAX_ICON_FILES {
+        kept.sort();
+        for (_, path) in &kept[..=kept.len() - MAX_ICON_FILES] {
+            let _ = std::fs::remove_file(path);
+        }
+    }
+}
+
+/// Render an icon to premultiplied BGRA. Drawing it over black gives the
+/// premultiplied colour; drawing it over white as well recovers alpha
+/// from the difference.
+unsafe fn rasterize_icon(icon: HICON, size: i32) -> Option<Vec<u32>> {
+    let on_black = draw_icon_on(icon, size, 0x0000_0000)?;
+    let on_white = draw_icon_on(icon, size, 0x00FF_FFFF)?;
+    let pixels = on_black
+        .iter()
+        .zip(&on_white)
+        .map(|(&b, &w)| {
+            let diff = ((w >> 8) & 0xFF).saturating_sub((b >> 8) & 0xFF);
+            let alpha = 255 - diff;
+            (alpha << 24) | (b & 0x00FF_FFFF)
+        })
+        .collect();
+    Some(pixels)
+}
+
+unsafe fn draw_icon_on(icon: HICON, size: i32, background: u32) -> Option<Vec<u32>> {
+    let dc = CreateCompatibleDC(None);
+    if dc.is_invalid() {
+        return None;
+    }
+    let bmi = BITMAPINFO {
+        bmiHeader: BITMAPINFOHEADER {
+            biSize: std::mem::size_of::<BITMAPINFOHEADER>() as u32,
+            biWidth: size,
+            biHeight: -size, // top-down
+            biPlanes: 1,
+            biBitCount: 32,
+            biCompression: BI_RGB.0,
+            ..Default::default()
+        },
+        ..Default::default()
+    };
+    let mut bits: *mut core::ffi::c_void = std::ptr::null_mut();
+    let bitmap = match CreateDIBSection(Some(dc), &bmi, DIB_RGB_COLORS, &mut bits, None, 0) {
+        Ok(b) if !bits.is_null() => b,
+        _ => {
+            let _ = DeleteDC(dc);
+            return None;
+        }
+    };
+    let old_bitmap = SelectObject(dc, HGDIOBJ(bitmap.0));
+
+    let pixels = std::slice::from_raw_parts_mut(bits as *mut u32, (size * size) as usize);
+    pixels.fill(background);
+    let _ = DrawIconEx(dc, 0, 0, icon, size, size, 0, None, DI_NORMAL);
+    let _ = GdiFlush();
+    let result = pixels.to_vec();
+
+    SelectObject(dc, old_bitmap);
+    let _ = DeleteObject(HGDIOBJ(bitmap.0));
+    let _ = DeleteDC(dc);
+    Some(result)
+}
+
+/// Default .ico loaded at `size`, once per process. Owned by the cache.
+pub fn default_icon(ico_path: &str, size: i32) -> HICON {
+    #[cfg(feature = "embed-assets")]
+    if ico_path == EMBEDDED_ICON {
+        return cached_icon(format!("ico|{}|{}", size, ico_path), || icon_from_ico_bytes(embedded::ICON, size));
+    }
+
+    cached_icon(format!("ico|{}|{}", size, ico_path), || {
+        let path_wide = crate::util::encode_wide(ico_path);
+        let result = unsafe {
+            LoadImageW(
+                None,
+                PCWSTR(path_wide.as_ptr()),
+                IMAGE_ICON,
+                size, size,
+                LR_LOADFROMFILE,
+            )
+        };
+        match result {
+            Ok(handle) => HICON(handle.0),
+            Err(_) => HICON::default(),
+        }
+    })
+}
+
+/// Build an icon from an in-memory .ico file, using the image whose width is
+/// closest to `size` (preferring larger ones, which scale down cleanly).
+#[cfg(feature = "embed-assets")]
+fn icon_from_ico_bytes(ico: &[u8], size: i32) -> HICON {
+    let read_u16 = |pos: usize| ico.get(pos..pos + 2).map(|b| u16::from_le_bytes([b[0], b[1]]));
+    let read_u32 = |pos: usize| ico.get(pos..pos + 4).map(|b| u32::from_le_bytes([b[0], b[1], b[2], b[3]]));
+
+    // ICONDIR: reserved u16, type u16 (1 = icon), count u16; then 16-byte entries
+    if read_u16(2) != Some(1) {
+        return HICON::default();
+    }
+    let count = read_u16(4).unwrap_or(0) as usize;
+
+    let mut best: Option<(i32, usize, usize)> = None;
+    for i in 0..count {
+        let entry = 6 + i * 16;
+        let Some(&width_byte) = ico.get(entry) else { break };
+        let width = if width_byte == 0 { 256 } else { width_byte as i32 };
+        let (Some(len), Some(offset)) = (read_u32(entry + 8), read_u32(entry + 12)) else { break };
+        // Smaller-than-requested images rank after all larger ones
+        let score = if width >= size { width - size } else { 1000 + size - width };
+        if best.map_or(true, |(s, _, _)| score < s) {
+            best = Some((score, offset as usize, len as usize));
+        }
+    }
+
+    let Some(image) = best.and_then(|(_, offset, len)| ico.get(offset..offset + len)) else {
+        return HICON::default();
+    };
+    unsafe {
+        CreateIconFromResourceEx(image, true, 0x0003_0000, size, size, LR_DEFAULTCOLOR)
+            .unwrap_or_default()
+    }
+}
+
 /// Extract the large icon from an exe file (index 0).
-pub fn extract_icon(exe_path: &str) -> HICON {
+fn extract_icon(exe_path: &str) -> HICON {
     if exe_path.is_empty() {
         return HICON::default();
     }
@@ -147,17 +595,48 @@ pub fn extract_icon(exe_path: &str) -> HICON {
     large
 }
 
-/// Play a notification sound (SPEC 12.2).
-pub fn play_sound(wav_path: &Option<String>) {
+#[cfg(feature = "embed-assets")]
+fn sound_bytes() -> Option<&'static [u8]> {
+    Some(embedded::SOUND)
+}
+
+#[cfg(not(feature = "embed-assets"))]
+fn sound_bytes() -> Option<&'static [u8]> {
+    SOUND_DATA.get().map(Vec::as_slice)
+}
+
+/// Read the WAV into memory so playback does not touch the disk.
+#[cfg(not(feature = "embed-assets"))]
+fn preload_sound(wav_path: &str) {
+    match std::fs::read(wav_path) {
+        Ok(data) if data.len() > 12 && &data[0..4] == b"RIFF" && &data[8..12] == b"WAVE" => {
+            let _ = SOUND_DATA.set(data);
+        }
+        _ => crate::debug_log!("Sound file unreadable or not WAV: {}", wav_path),
+    }
+}
+
+/// Play the notification sound (SPEC 12.2) from the preloaded WAV.
+/// Calls within SOUND_COALESCE of the previous one are dropped, so a burst
+/// of toasts sounds once instead of restarting the same clip.
+pub fn play_sound() {
     use windows::Win32::Media::Audio::*;
 
-    if let Some(path) = wav_path {
-        let path_wide = crate::util::encode_wide(path);
+    {
+        let mut last = LAST_SOUND.lock().unwrap_or_else(|e| e.into_inner());
+        let now = Instant::now();
+        if last.is_some_and(|t| now.duration_since(t) < SOUND_COALESCE) {
+            return;
+        }
+        *last = Some(now);
+    }
+
+    if let Some(data) = sound_bytes() {
         unsafe {
             let result = PlaySoundW(
-                PCWSTR(path_wide.as_ptr()),
+                PCWSTR(data.as_ptr() as *const u16),
                 None,
-                SND_FILENAME | SND_ASYNC,
+                SND_MEMORY | SND_ASYNC | SND_NODEFAULT,
             );
             if result.as_bool() {
                 return;
@@ -1,7 +1,15 @@
 //! CLI argument parsing for ToastWindow.
 //!
-//! Modes: --save, --notify, --input, --notify-show, --cleanup
-//! Flags: --debug/-d, --input-mode, --session <val>, --message <val>
+//! Modes: --save, --notify, --input, --notify-show, --host, --resolve, --cleanup
+//! Flags: --debug/-d, --input-mode, --session <val>, --message <val>,
+//!        --preview-chars <n>, --defer, --stamp <n>,
+//!        --batch-ms <n>, --stdin-request, --relay [addr]
+
+/// Prompt characters kept beyond what the toast displays (--preview-chars).
+pub const DEFAULT_PREVIEW_CHARS: usize = 64;
+
+/// Window in which the host merges notification bursts (--batch-ms, 0 = off).
+pub const DEFAULT_BATCH_MS: u32 = 250;
 
 #[derive(Debug, PartialEq)]
 pub enum Mode {
@@ -9,6 +17,8 @@ pub enum Mode {
     Notify,
     Input,
     NotifyShow,
+    Host,
+    Resolve,
     Cleanup,
     None,
 }
@@ -20,6 +30,14 @@ pub struct Args {
     pub input_mode: bool,
     pub session: String,
     pub message: String,
+    pub preview_chars: usize,
+    pub defer: bool,
+    pub stamp: u64,
+    pub batch_ms: u32,
+    /// Read the notification request as JSON from stdin (set by `host::dispatch`)
+    pub stdin_request: bool,
+    /// Address the host listens on for relayed hook events (--relay)
+    pub relay: Option<String>,
 }
 
 pub fn parse_args() -> Args {
@@ -30,6 +48,12 @@ pub fn parse_args() -> Args {
         input_mode: false,
         session: String::new(),
         message: String::new(),
+        preview_chars: DEFAULT_PREVIEW_CHARS,
+        defer: false,
+        stamp: 0,
+        batch_ms: DEFAULT_BATCH_MS,
+        stdin_request: false,
+        relay: None,
     };
 
     let mut i = 1;
@@ -39,9 +63,13 @@ pub fn parse_args() -> Args {
             "--notify" => result.mode = Mode::Notify,
             "--input" => result.mode = Mode::Input,
             "--notify-show" => result.mode = Mode::NotifyShow,
+            "--host" => result.mode = Mode::Host,
+            "--resolve" => result.mode = Mode::Resolve,
             "--cleanup" => result.mode = Mode::Cleanup,
             "--debug" | "-d" => result.debug = true,
             "--input-mode" => result.input_mode = true,
+            "--defer" => result.defer = true,
+            "--stdin-request" => result.stdin_request = true,
             "--session" => {
                 i += 1;
                 if i < args.len() {
@@ -54,6 +82,34 @@ pub fn parse_args() -> Args {
                     result.message = args[i].clone();
                 }
             }
+            "--preview-chars" => {
+                i += 1;
+                if i < args.len() {
+                    result.preview_chars = args[i].parse().unwrap_or(DEFAULT_PREVIEW_CHARS);
+                }
+            }
+            "--stamp" => {
+                i += 1;
+                if i < args.len() {
+                    result.stamp = args[i].parse().unwrap_or(0);
+                }
+            }
+            "--batch-ms" => {
+                i += 1;
+                if i < args.len() {
+                    result.batch_ms = args[i].parse().unwrap_or(DEFAULT_BATCH_MS);
+                }
+            }
+            "--relay" => {
+                // The address is optional: a bare --relay uses the default port
+                match args.get(i + 1) {
+                    Some(addr) if !addr.starts_with("--") => {
+                        i += 1;
+                        result.relay = Some(addr.clone());
+                    }
+                    _ => result.relay = Some(String::new()),
+                }
+            }
             _ => {}
         }
         i += 1;
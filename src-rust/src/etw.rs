@@ -0,0 +1,80 @@
+//! ETW provider for correlating notifier latency with the rest of the
+//! system in WPA.
+//!
+//! Provider GUID {b5f9f91a-724b-4d6d-834a-0745f474582a}. Events are plain
+//! strings (EventWriteString), so no manifest has to be installed:
+//!
+//! ```text
+//! xperf -start toast -on b5f9f91a-724b-4d6d-834a-0745f474582a -f toast.etl
+//! xperf -stop toast
+//! ```
+//!
+//! `etw_event!` checks EventProviderEnabled first and formats nothing when
+//! no session is listening.
+
+use std::sync::OnceLock;
+
+use windows::core::{GUID, PCWSTR};
+
+const PROVIDER_ID: GUID = GUID::from_u128(0xb5f9f91a_724b_4d6d_834a_0745f474582a);
+
+/// TRACE_LEVEL_INFORMATION
+const LEVEL_INFO: u8 = 4;
+
+static REG_HANDLE: OnceLock<u64> = OnceLock::new();
+
+#[link(name = "advapi32")]
+extern "system" {
+    fn EventRegister(
+        provider_id: *const GUID,
+        enable_callback: *const core::ffi::c_void,
+        callback_context: *const core::ffi::c_void,
+        reg_handle: *mut u64,
+    ) -> u32;
+    fn EventUnregister(reg_handle: u64) -> u32;
+    fn EventProviderEnabled(reg_handle: u64, level: u8, keyword: u64) -> u8;
+    fn EventWriteString(reg_handle: u64, level: u8, keyword: u64, string: PCWSTR) -> u32;
+}
+
+/// Register the provider. Call once at startup.
+pub fn register() {
+    let mut handle = 0u64;
+    let status = unsafe {
+        EventRegister(&PROVIDER_ID, std::ptr::null(), std::ptr::null(), &mut handle)
+    };
+    if status == 0 {
+        let _ = REG_HANDLE.set(handle);
+    }
+}
+
+/// Unregister the provider. Call before `std::process::exit`.
+pub fn unregister() {
+    if let Some(&handle) = REG_HANDLE.get() {
+        unsafe { EventUnregister(handle); }
+    }
+}
+
+/// Whether any trace session has enabled this provider.
+pub fn enabled() -> bool {
+    match REG_HANDLE.get() {
+        Some(&handle) => unsafe { EventProviderEnabled(handle, LEVEL_INFO, 0) != 0 },
+        None => false,
+    }
+}
+
+/// Write one string event.
+pub fn write(msg: &str) {
+    let Some(&handle) = REG_HANDLE.get() else { return };
+    let wide = crate::util::encode_wide(msg);
+    unsafe { EventWriteString(handle, LEVEL_INFO, 0, PCWSTR(wide.as_ptr())); }
+}
+
+/// Emit a formatted ETW event if a trace session is listening.
+#[macro_export]
+macro_rules! etw_event {
+    ($($arg:tt)*) => {
+        if $crate::etw::enabled() {
+            $crate::etw::write(&format!($($arg)*))
+        }
+    };
+}
@@ -0,0 +1,739 @@
+//! Long-lived toast host.
+//!
+//! A single host process per desktop session owns every toast. Hook
+//! invocations hand their request to it with WM_COPYDATA, so COM init,
+//! asset discovery, font registration and window-class registration
+//! happen once instead of once per notification. The host is started on
+//! first use with the triggering request on its command line, and exits
+//! after being idle for HOST_IDLE_MS.
+//!
+//! The first request after a quiet period is shown at once and opens a
+//! short batch window (--batch-ms). Requests arriving while it is open are
+//! held until it closes: those for the same session and mode merge into
+//! one toast with a count, and a burst spanning many sessions becomes one
+//! grouped toast per mode. The window stays open while held requests keep
+//! arriving.
+//!
+//! At most `toast::stack_capacity()` toasts are on screen at once. Further
+//! requests wait in an overflow queue, merged per session and mode, and
+//! get a window when a visible toast closes.
+//!
+//! An input request for a session that already has a live input toast
+//! updates that toast (new message, count, restarted display time)
+//! instead of opening another one. The toast confirms each update it shows;
+//! one it closes without showing is queued as a toast of its own.
+//!
+//! One warm thread per style waits with a hidden, pre-rendered toast
+//! window, so a new toast only needs its text and icon drawn before it is
+//! shown. A used warm thread is replaced right away.
+//!
+//! With --relay the host also accepts hook events from other machines
+//! (see `relay`) and stays up instead of exiting when idle. A `--host
+//! --relay` that finds a host already running asks it to start the relay.
+
+use std::sync::atomic::{AtomicBool, AtomicIsize, AtomicU32, AtomicU64, AtomicUsize, Ordering};
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex, OnceLock};
+
+use windows::core::*;
+use windows::Win32::Foundation::*;
+use windows::Win32::System::Com::*;
+use windows::Win32::System::Console::{AttachConsole, ATTACH_PARENT_PROCESS};
+use windows::Win32::System::DataExchange::COPYDATASTRUCT;
+use windows::Win32::System::LibraryLoader::GetModuleHandleW;
+use windows::Win32::System::Threading::{
+    CreateMutexW, GetCurrentProcess, GetCurrentThread, GetCurrentThreadId, SetPriorityClass,
+    SetThreadPriority, NORMAL_PRIORITY_CLASS, THREAD_PRIORITY_NORMAL,
+};
+use windows::Win32::UI::WindowsAndMessaging::*;
+
+use crate::debug_log;
+use crate::notify::{self, Request};
+use crate::{assets, cli, relay, spawn, toast};
+
+const HOST_CLASS_NAME: &str = "ClaudeCodeToastHost";
+const HOST_MUTEX_NAME: &str = "Local\\ClaudeCodeToastHost";
+
+/// WM_COPYDATA tag identifying a serialized `Request` ('CNTQ').
+const COPYDATA_REQUEST: usize = 0x434E_5451;
+/// WM_COPYDATA tag asking the host to start the relay on a UTF-8 address ('CNTR').
+const COPYDATA_RELAY: usize = 0x434E_5452;
+
+const SEND_TIMEOUT_MS: u32 = 500;
+const HANDOFF_RETRIES: u32 = 20;
+const HANDOFF_RETRY_MS: u64 = 25;
+
+/// Posted to the host window by a toast thread when its toast has closed.
+const WM_HOST_TOAST_DONE: u32 = WM_APP + 1;
+/// Thread message to a warm toast thread; lparam owns a boxed
+/// (Request, toast id).
+const WM_POOL_SHOW: u32 = WM_APP + 2;
+/// Posted to the host window once the first toast is on screen.
+const WM_HOST_TOAST_SHOWN: u32 = WM_APP + 3;
+
+const TIMER_IDLE: usize = 1;
+const TIMER_BATCH: usize = 2;
+const HOST_IDLE_MS: u32 = 30 * 60 * 1000;
+
+/// More distinct sessions than this in one batch are shown as one grouped
+/// toast per mode instead of one toast each.
+const GROUP_THRESHOLD: usize = 3;
+
+static HOST_ASSETS: OnceLock<Arc<assets::LoadedAssets>> = OnceLock::new();
+static HOST_HWND: AtomicIsize = AtomicIsize::new(0);
+static ACTIVE_TOASTS: AtomicUsize = AtomicUsize::new(0);
+static BATCH_MS: AtomicU32 = AtomicU32::new(cli::DEFAULT_BATCH_MS);
+/// Set while the relay listener runs; the host then never idles out.
+static RELAY_ACTIVE: AtomicBool = AtomicBool::new(false);
+
+/// Requests waiting for the batch window to close, in arrival order.
+static PENDING: Mutex<Vec<Request>> = Mutex::new(Vec::new());
+/// Set while a batch window is open (TIMER_BATCH running).
+static BATCH_OPEN: AtomicBool = AtomicBool::new(false);
+/// Set once the startup priority boost has been handed back.
+static PRIORITY_RESTORED: AtomicBool = AtomicBool::new(false);
+
+/// Requests waiting for a free stack slot, oldest first.
+static OVERFLOW: Mutex<Vec<Request>> = Mutex::new(Vec::new());
+
+/// A pool thread holding a prepared toast window for one style.
+/// `thread_id` is set once the window exists and the thread is pumping.
+struct WarmThread {
+    input_mode: bool,
+    thread_id: Option<u32>,
+}
+
+static POOL: Mutex<Vec<WarmThread>> = Mutex::new(Vec::new());
+
+/// A session's live input toast.
+struct LiveInput {
+    /// Events it stands for, including an update not yet on screen
+    count: u32,
+    /// Which toast this is, so a closing toast only removes its own entry
+    toast_id: u64,
+    /// The last update handed to it until the toast confirms showing it
+    unconfirmed: Option<Request>,
+}
+
+/// Sessions with a live input toast.
+static LIVE_INPUT: Mutex<Option<HashMap<String, LiveInput>>> = Mutex::new(None);
+static NEXT_TOAST_ID: AtomicU64 = AtomicU64::new(1);
+
+// --- Client side (hook process) ---
+
+/// Hand a request to a running host. Returns false if no host answered.
+pub fn send_request(req: &Request) -> bool {
+    let payload = match serde_json::to_vec(req) {
+        Ok(p) => p,
+        Err(_) => return false,
+    };
+    send_copydata(COPYDATA_REQUEST, &payload) == Some(1)
+}
+
+/// Send `payload` under `tag` to the running host. Returns its reply, or
+/// None if no host answered.
+fn send_copydata(tag: usize, payload: &[u8]) -> Option<usize> {
+    let class_wide = crate::util::encode_wide(HOST_CLASS_NAME);
+    let hwnd = match unsafe { FindWindowW(PCWSTR(class_wide.as_ptr()), PCWSTR::null()) } {
+        Ok(h) if !h.is_invalid() => h,
+        _ => return None,
+    };
+
+    let cds = COPYDATASTRUCT {
+        dwData: tag,
+        cbData: payload.len() as u32,
+        lpData: payload.as_ptr() as *mut _,
+    };
+
+    let mut result: usize = 0;
+    let sent = unsafe {
+        SendMessageTimeoutW(
+            hwnd,
+            WM_COPYDATA,
+            WPARAM(0),
+            LPARAM(&cds as *const COPYDATASTRUCT as isize),
+            SMTO_ABORTIFHUNG | SMTO_BLOCK,
+            SEND_TIMEOUT_MS,
+            Some(&mut result),
+        )
+    };
+    (sent.0 != 0).then_some(result)
+}
+
+/// Deliver a request to the host, starting one with the request if none is running.
+pub fn dispatch(req: &Request, args: &cli::Args) -> bool {
+    if send_request(req) {
+        debug_log!("Request handed to running host");
+        return true;
+    }
+
+    // The request travels on the child's stdin, so the message needs no
+    // command-line quoting and has no length limit
+    let payload = match serde_json::to_vec(req) {
+        Ok(p) => p,
+        Err(_) => return false,
+    };
+    let mut cmd = format!("\"{}\" --host --stdin-request", crate::util::exe_path());
+    if args.batch_ms != cli::DEFAULT_BATCH_MS {
+        cmd.push_str(&format!(" --batch-ms {}", args.batch_ms));
+    }
+    if args.debug {
+        cmd.push_str(" --debug");
+    }
+
+    debug_log!("No host running, spawning: {}", cmd);
+    spawn::spawn_with_payload(&cmd, &payload, true)
+}
+
+// --- Host side ---
+
+/// Run the host message loop. `initial` is the request that started the
+/// host; `relay` is the --relay listen address, if any.
+pub fn run_host(initial: Option<Request>, batch_ms: u32, relay: Option<&str>) -> i32 {
+    let mutex_name = crate::util::encode_wide(HOST_MUTEX_NAME);
+    let mutex = unsafe { CreateMutexW(None, false, PCWSTR(mutex_name.as_ptr())) }
+        .unwrap_or_default();
+
+    if unsafe { GetLastError() } == ERROR_ALREADY_EXISTS {
+        // Another host won the race; it may still be creating its window.
+        debug_log!("Host already running, forwarding request");
+        let mut exit_code = 0;
+        if let Some(addr) = relay {
+            // The running host may have been started by a hook, without --relay
+            if !forward_relay(addr) {
+                report_error(&format!("relay on {:?} could not be started in the running host", addr));
+                exit_code = 1;
+            }
+        }
+        if let Some(req) = initial {
+            forward_or_show(&req);
+        }
+        unsafe { let _ = CloseHandle(mutex); }
+        return exit_code;
+    }
+
+    let loaded = Arc::new(assets::load_assets());
+    let _ = HOST_ASSETS.set(loaded.clone());
+
+    // Once per host lifetime, away from the toast path
+    let _ = std::thread::Builder::new()
+        .name("legacy-state-sweep".to_string())
+        .spawn(crate::state::remove_legacy_files);
+
+    let hwnd = create_host_window();
+    if hwnd.is_invalid() {
+        debug_log!("Host window creation failed");
+        if let Some(req) = initial {
+            notify::show_notification(&req, &loaded);
+        }
+        loaded.release();
+        toast::release_gdi_cache();
+        unsafe { let _ = CloseHandle(mutex); }
+        return 1;
+    }
+
+    debug_log!("Host started: {:?}, batch window {} ms", hwnd, batch_ms);
+    BATCH_MS.store(batch_ms, Ordering::SeqCst);
+    HOST_HWND.store(hwnd.0 as isize, Ordering::SeqCst);
+    warm_pool();
+    if let Some(req) = initial {
+        queue_request(hwnd, req);
+    }
+    if let Some(addr) = relay {
+        if !start_relay(addr) {
+            report_error(&format!("relay on {:?} could not be started", addr));
+        }
+    }
+
+    unsafe {
+        SetTimer(Some(hwnd), TIMER_IDLE, HOST_IDLE_MS, None);
+
+        let mut msg = MSG::default();
+        while GetMessageW(&mut msg, None, 0, 0).as_bool() {
+            let _ = TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+    }
+
+    debug_log!("Host exiting");
+    loaded.release();
+    toast::release_gdi_cache();
+    unsafe { let _ = CloseHandle(mutex); }
+    0
+}
+
+/// Ask the running host to start the relay on `addr`. Returns false if it
+/// could not, or never answered.
+fn forward_relay(addr: &str) -> bool {
+    for _ in 0..HANDOFF_RETRIES {
+        if let Some(reply) = send_copydata(COPYDATA_RELAY, addr.as_bytes()) {
+            return reply == 1;
+        }
+        std::thread::sleep(std::time::Duration::from_millis(HANDOFF_RETRY_MS));
+    }
+    false
+}
+
+/// Start the relay listener in this host unless it already runs one.
+fn start_relay(addr: &str) -> bool {
+    if RELAY_ACTIVE.load(Ordering::SeqCst) {
+        debug_log!("Relay already running, ignoring {}", addr);
+        return true;
+    }
+    let started = relay::start(addr);
+    RELAY_ACTIVE.store(started, Ordering::SeqCst);
+    started
+}
+
+/// Report a failure to the user: in the debug log, and on the console this
+/// (GUI subsystem) process was started from, if there is one.
+fn report_error(msg: &str) {
+    debug_log!("Error: {}", msg);
+    unsafe { let _ = AttachConsole(ATTACH_PARENT_PROCESS); }
+    eprintln!("ToastWindow: {}", msg);
+}
+
+fn forward_or_show(req: &Request) {
+    for _ in 0..HANDOFF_RETRIES {
+        if send_request(req) {
+            return;
+        }
+        std::thread::sleep(std::time::Duration::from_millis(HANDOFF_RETRY_MS));
+    }
+
+    // Host never answered: show the toast from this process instead.
+    debug_log!("Host did not answer, showing toast locally");
+    let loaded = assets::load_assets();
+    notify::show_notification(req, &loaded);
+    loaded.release();
+    toast::release_gdi_cache();
+}
+
+fn create_host_window() -> HWND {
+    unsafe {
+        let instance = GetModuleHandleW(None).unwrap_or_default();
+        let class_wide = crate::util::encode_wide(HOST_CLASS_NAME);
+
+        let wc = WNDCLASSEXW {
+            cbSize: std::mem::size_of::<WNDCLASSEXW>() as u32,
+            lpfnWndProc: Some(host_wnd_proc),
+            hInstance: instance.into(),
+            lpszClassName: PCWSTR(class_wide.as_ptr()),
+            ..Default::default()
+        };
+        let _ = RegisterClassExW(&wc);
+
+        // Hidden top-level window (not message-only) so FindWindowW can
+        // locate it and it receives display/setting broadcasts.
+        CreateWindowExW(
+            WS_EX_TOOLWINDOW,
+            PCWSTR(class_wide.as_ptr()),
+            w!("ClaudeCodeToastHost"),
+            WS_POPUP,
+            0, 0, 0, 0,
+            None, None, Some(instance.into()), None,
+        ).unwrap_or_default()
+    }
+}
+
+/// Show a request at once if no batch window is open, opening one.
+/// Otherwise hold it until the window closes, merged into a pending
+/// request for the same session and mode.
+fn queue_request(hwnd: HWND, mut req: Request) {
+    let batch_ms = BATCH_MS.load(Ordering::SeqCst);
+    req.count = req.count.max(1);
+    if batch_ms == 0 {
+        spawn_toast(req);
+        return;
+    }
+
+    let mut pending = PENDING.lock().unwrap_or_else(|e| e.into_inner());
+    if !BATCH_OPEN.swap(true, Ordering::SeqCst) {
+        drop(pending);
+        unsafe { SetTimer(Some(hwnd), TIMER_BATCH, batch_ms, None); }
+        spawn_toast(req);
+        return;
+    }
+    match pending
+        .iter_mut()
+        .find(|p| p.session == req.session && p.input_mode == req.input_mode)
+    {
+        Some(existing) => merge_into(existing, req),
+        None => pending.push(req),
+    }
+}
+
+/// Fold `newer` into `batch`: counts add up, the latest message wins.
+fn merge_into(batch: &mut Request, newer: Request) {
+    batch.count += newer.count;
+    batch.session = newer.session;
+    if !newer.message.is_empty() {
+        batch.message = newer.message;
+    }
+}
+
+/// Turn the pending batch into toasts. Returns false if nothing was held.
+fn flush_batch() -> bool {
+    let batch = std::mem::take(&mut *PENDING.lock().unwrap_or_else(|e| e.into_inner()));
+    if batch.is_empty() {
+        return false;
+    }
+    debug_log!("Flushing batch of {} request(s)", batch.len());
+
+    let mut sessions: Vec<&str> = batch.iter().map(|r| r.session.as_str()).collect();
+    sessions.sort_unstable();
+    sessions.dedup();
+    if sessions.len() <= GROUP_THRESHOLD {
+        for req in batch {
+            spawn_toast(req);
+        }
+        return true;
+    }
+
+    // Burst across many sessions: one toast per mode, pointing at the
+    // latest session
+    for input_mode in [false, true] {
+        let mut group: Option<Request> = None;
+        for req in batch.iter().filter(|r| r.input_mode == input_mode) {
+            match group.as_mut() {
+                Some(g) => merge_into(g, req.clone()),
+                None => group = Some(req.clone()),
+            }
+        }
+        if let Some(req) = group {
+            spawn_toast(req);
+        }
+    }
+    true
+}
+
+/// Show a request now if the stack has room, otherwise queue it, merged
+/// with any queued request for the same session and mode.
+fn spawn_toast(req: Request) {
+    if req.input_mode && fold_into_live_toast(&req) {
+        return;
+    }
+
+    let mut overflow = OVERFLOW.lock().unwrap_or_else(|e| e.into_inner());
+    if overflow.is_empty() && ACTIVE_TOASTS.load(Ordering::SeqCst) < toast::stack_capacity() {
+        drop(overflow);
+        start_toast_thread(req);
+        return;
+    }
+
+    match overflow
+        .iter_mut()
+        .find(|p| p.session == req.session && p.input_mode == req.input_mode)
+    {
+        Some(existing) => merge_into(existing, req),
+        None => overflow.push(req),
+    }
+    debug_log!("Stack full, {} request(s) queued", overflow.len());
+}
+
+/// Hand an input request to the session's live input toast. Returns false
+/// if the session has none. Until the toast confirms the update, the merged
+/// request is kept, so it can still get a toast of its own if the live one
+/// closes first (see `run_toast`).
+fn fold_into_live_toast(req: &Request) -> bool {
+    let mut live = LIVE_INPUT.lock().unwrap_or_else(|e| e.into_inner());
+    let Some(entry) = live.as_mut().and_then(|m| m.get_mut(&req.session)) else { return false };
+
+    let merged = Request { count: entry.count + req.count, ..req.clone() };
+    let (session, toast_id, count) = (req.session.clone(), entry.toast_id, merged.count);
+    if !notify::update_notification(&merged, move || confirm_update(&session, toast_id, count)) {
+        return false;
+    }
+    entry.count = merged.count;
+    entry.unconfirmed = Some(merged);
+    debug_log!("Input toast for session {} updated ({} events)", req.session, count);
+    true
+}
+
+/// Called on a toast's thread once it shows the update carrying `count`.
+fn confirm_update(session: &str, toast_id: u64, count: u32) {
+    let mut live = LIVE_INPUT.lock().unwrap_or_else(|e| e.into_inner());
+    let Some(entry) = live.as_mut().and_then(|m| m.get_mut(session)) else { return };
+    if entry.toast_id == toast_id && entry.unconfirmed.as_ref().is_some_and(|u| u.count <= count) {
+        entry.unconfirmed = None;
+    }
+}
+
+/// Fill free stack slots from the overflow queue.
+fn drain_overflow() {
+    let capacity = toast::stack_capacity();
+    loop {
+        let next = {
+            let mut overflow = OVERFLOW.lock().unwrap_or_else(|e| e.into_inner());
+            if overflow.is_empty() || ACTIVE_TOASTS.load(Ordering::SeqCst) >= capacity {
+                return;
+            }
+            overflow.remove(0)
+        };
+        start_toast_thread(next);
+    }
+}
+
+/// Run one notification on its own UI thread. Each toast keeps its
+/// thread-local state and message loop, exactly as in a standalone process.
+/// A warm pool thread of the right style is used when one is ready.
+fn start_toast_thread(req: Request) {
+    let Some(loaded) = HOST_ASSETS.get().cloned() else { return };
+
+    ACTIVE_TOASTS.fetch_add(1, Ordering::SeqCst);
+    let toast_id = NEXT_TOAST_ID.fetch_add(1, Ordering::SeqCst);
+    if req.input_mode {
+        LIVE_INPUT
+            .lock()
+            .unwrap_or_else(|e| e.into_inner())
+            .get_or_insert_with(HashMap::new)
+            .insert(req.session.clone(), LiveInput { count: req.count, toast_id, unconfirmed: None });
+    }
+
+    let req = match hand_to_warm_thread(req, toast_id) {
+        Ok(()) => {
+            warm_pool();
+            return;
+        }
+        Err(req) => req,
+    };
+
+    let session = req.session.clone();
+    let spawned = std::thread::Builder::new()
+        .name("toast".to_string())
+        .spawn(move || {
+            unsafe { let _ = CoInitializeEx(None, COINIT_APARTMENTTHREADED); }
+            run_toast(&req, toast_id, &loaded);
+        });
+
+    if spawned.is_err() {
+        debug_log!("Failed to start toast thread");
+        forget_live_input(&session, toast_id);
+        ACTIVE_TOASTS.fetch_sub(1, Ordering::SeqCst);
+    }
+}
+
+/// Drop the session's live input entry if it still belongs to `toast_id`
+/// (a newer input toast for the session may have replaced it already).
+/// Returns an update the toast closed without showing.
+fn forget_live_input(session: &str, toast_id: u64) -> Option<Request> {
+    let mut live = LIVE_INPUT.lock().unwrap_or_else(|e| e.into_inner());
+    let map = live.as_mut()?;
+    if !map.get(session).is_some_and(|e| e.toast_id == toast_id) {
+        return None;
+    }
+    map.remove(session).and_then(|e| e.unconfirmed)
+}
+
+/// Put a request at the front of the overflow queue, so it is shown as soon
+/// as a slot is free.
+fn requeue(req: Request) {
+    let mut overflow = OVERFLOW.lock().unwrap_or_else(|e| e.into_inner());
+    match overflow
+        .iter_mut()
+        .find(|p| p.session == req.session && p.input_mode == req.input_mode)
+    {
+        Some(existing) => merge_into(existing, req),
+        None => overflow.insert(0, req),
+    }
+}
+
+/// Show a toast on the current (COM-initialized) thread, then release the
+/// thread's resources and tell the host the slot is free.
+fn run_toast(req: &Request, toast_id: u64, loaded: &assets::LoadedAssets) {
+    notify::show_notification(req, loaded);
+    if req.input_mode {
+        if let Some(lost) = forget_live_input(&req.session, toast_id) {
+            // Closed before it showed the last update: that event gets its own toast
+            debug_log!("Input toast for session {} closed before its update", lost.session);
+            requeue(lost);
+        }
+    }
+    crate::uiautomation::release_automation();
+    unsafe { CoUninitialize(); }
+    ACTIVE_TOASTS.fetch_sub(1, Ordering::SeqCst);
+
+    // Let the host fill the freed slot
+    let host = HWND(HOST_HWND.load(Ordering::SeqCst) as *mut _);
+    if !host.is_invalid() {
+        unsafe { let _ = PostMessageW(Some(host), WM_HOST_TOAST_DONE, WPARAM(0), LPARAM(0)); }
+    }
+}
+
+/// Called by a toast thread once its window is visible. The host was
+/// started at above-normal priority (see `dispatch`) to get its first toast
+/// up quickly; after that it runs at normal priority for the rest of its life.
+pub fn toast_shown() {
+    let host = HWND(HOST_HWND.load(Ordering::SeqCst) as *mut _);
+    if host.is_invalid() || PRIORITY_RESTORED.swap(true, Ordering::SeqCst) {
+        return;
+    }
+    unsafe { let _ = PostMessageW(Some(host), WM_HOST_TOAST_SHOWN, WPARAM(0), LPARAM(0)); }
+}
+
+// --- Warm toast pool ---
+
+/// Keep one warm thread per style (completion, input) ready.
+fn warm_pool() {
+    for input_mode in [false, true] {
+        {
+            let mut pool = POOL.lock().unwrap_or_else(|e| e.into_inner());
+            if pool.iter().any(|w| w.input_mode == input_mode) {
+                continue;
+            }
+            pool.push(WarmThread { input_mode, thread_id: None });
+        }
+        let spawned = std::thread::Builder::new()
+            .name("toast-warm".to_string())
+            .spawn(move || run_warm_thread(input_mode));
+        if spawned.is_err() {
+            POOL.lock()
+                .unwrap_or_else(|e| e.into_inner())
+                .retain(|w| w.input_mode != input_mode || w.thread_id.is_some());
+        }
+    }
+}
+
+/// Give `req` to a ready warm thread of its style, or hand it back.
+fn hand_to_warm_thread(req: Request, toast_id: u64) -> std::result::Result<(), Request> {
+    let thread_id = {
+        let mut pool = POOL.lock().unwrap_or_else(|e| e.into_inner());
+        let Some(index) = pool
+            .iter()
+            .position(|w| w.input_mode == req.input_mode && w.thread_id.is_some())
+        else {
+            return Err(req);
+        };
+        pool.remove(index).thread_id.unwrap_or_default()
+    };
+
+    let boxed = Box::into_raw(Box::new((req, toast_id)));
+    let posted = unsafe {
+        PostThreadMessageW(thread_id, WM_POOL_SHOW, WPARAM(0), LPARAM(boxed as isize))
+    }.is_ok();
+    if posted {
+        crate::etw_event!("toast handed to warm thread {}", thread_id);
+        Ok(())
+    } else {
+        Err(unsafe { Box::from_raw(boxed) }.0)
+    }
+}
+
+/// Prepare a hidden toast window, pump its messages until the host posts
+/// a request (WM_POOL_SHOW), then show it.
+fn run_warm_thread(input_mode: bool) {
+    let Some(loaded) = HOST_ASSETS.get().cloned() else { return };
+    unsafe { let _ = CoInitializeEx(None, COINIT_APARTMENTTHREADED); }
+    toast::prepare_toast(input_mode);
+
+    let thread_id = unsafe { GetCurrentThreadId() };
+    for w in POOL.lock().unwrap_or_else(|e| e.into_inner()).iter_mut() {
+        if w.input_mode == input_mode && w.thread_id.is_none() {
+            w.thread_id = Some(thread_id);
+            break;
+        }
+    }
+
+    let req = unsafe {
+        let mut msg = MSG::default();
+        loop {
+            if !GetMessageW(&mut msg, None, 0, 0).as_bool() {
+                break None;
+            }
+            if msg.hwnd.is_invalid() && msg.message == WM_POOL_SHOW {
+                break Some(*Box::from_raw(msg.lParam.0 as *mut (Request, u64)));
+            }
+            let _ = TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+    };
+
+    match req {
+        Some((req, toast_id)) => run_toast(&req, toast_id, &loaded),
+        None => unsafe { CoUninitialize(); },
+    }
+}
+
+unsafe extern "system" fn host_wnd_proc(
+    hwnd: HWND,
+    msg: u32,
+    wparam: WPARAM,
+    lparam: LPARAM,
+) -> LRESULT {
+    match msg {
+        WM_COPYDATA => {
+            let cds = &*(lparam.0 as *const COPYDATASTRUCT);
+            if cds.lpData.is_null() {
+                return LRESULT(0);
+            }
+            let bytes = std::slice::from_raw_parts(cds.lpData as *const u8, cds.cbData as usize);
+            if cds.dwData == COPYDATA_RELAY {
+                let addr = String::from_utf8_lossy(bytes);
+                return LRESULT(start_relay(&addr) as isize);
+            }
+            if cds.dwData != COPYDATA_REQUEST {
+                return LRESULT(0);
+            }
+            match serde_json::from_slice::<Request>(bytes) {
+                Ok(req) => {
+                    debug_log!("Host request: {:?}", req);
+                    // Restart the idle countdown
+                    SetTimer(Some(hwnd), TIMER_IDLE, HOST_IDLE_MS, None);
+                    queue_request(hwnd, req);
+                    LRESULT(1)
+                }
+                Err(_) => LRESULT(0),
+            }
+        }
+
+        WM_TIMER => {
+            match wparam.0 {
+                TIMER_BATCH => {
+                    // Close the window after one interval with nothing held
+                    if !flush_batch() {
+                        let _ = KillTimer(Some(hwnd), TIMER_BATCH);
+                        BATCH_OPEN.store(false, Ordering::SeqCst);
+                    }
+                }
+                TIMER_IDLE => {
+                    let idle = !RELAY_ACTIVE.load(Ordering::SeqCst)
+                        && ACTIVE_TOASTS.load(Ordering::SeqCst) == 0
+                        && PENDING.lock().unwrap_or_else(|e| e.into_inner()).is_empty()
+                        && OVERFLOW.lock().unwrap_or_else(|e| e.into_inner()).is_empty();
+                    if idle {
+                        let _ = DestroyWindow(hwnd);
+                    }
+                }
+                _ => {}
+            }
+            LRESULT(0)
+        }
+
+        WM_HOST_TOAST_DONE => {
+            drain_overflow();
+            LRESULT(0)
+        }
+
+        WM_HOST_TOAST_SHOWN => {
+            // Only the main thread was boosted; the class covers the rest
+            let _ = SetPriorityClass(GetCurrentProcess(), NORMAL_PRIORITY_CLASS);
+            let _ = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+            debug_log!("Startup priority boost released");
+            LRESULT(0)
+        }
+
+        WM_DISPLAYCHANGE | WM_SETTINGCHANGE => {
+            // Work areas, DPIs or the taskbar may have moved
+            toast::invalidate_monitor_cache();
+            DefWindowProcW(hwnd, msg, wparam, lparam)
+        }
+
+        WM_DESTROY => {
+            HOST_HWND.store(0, Ordering::SeqCst);
+            PostQuitMessage(0);
+            LRESULT(0)
+        }
+
+        _ => DefWindowProcW(hwnd, msg, wparam, lparam),
+    }
+}
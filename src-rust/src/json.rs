@@ -1,27 +1,562 @@
-//! Stdin JSON reading and field extraction.
+//! Stdin JSON reading and hook payload parsing.
 //!
-//! Reads stdin in binary mode, parses as JSON via serde_json,
-//! and extracts string fields.
+//! Reads stdin in binary mode and deserializes the hook payload once
+//! via serde_json into a typed struct that borrows from the input.
+//! The UserPromptSubmit payload is streamed instead, so a huge prompt is
+//! never held in memory.
 
+use std::borrow::Cow;
 use std::io::Read;
 
+use serde::Deserialize;
+
+/// The hook payload fields ToastWindow uses. Other keys are skipped
+/// without being materialized. Strings borrow from the input buffer and
+/// are only copied when they contain escape sequences.
+#[derive(Debug, Default, Deserialize)]
+pub struct HookPayload<'a> {
+    #[serde(borrow, default)]
+    pub session_id: Cow<'a, str>,
+    #[serde(borrow, default)]
+    pub message: Cow<'a, str>,
+}
+
 /// Read all of stdin into a String.
 /// Mirrors the C++ ReadStdinJson() which reads in binary mode with fread in 4096 chunks.
+/// Valid UTF-8 (the normal case) is taken over without a copy.
 pub fn read_stdin_json() -> String {
     let mut buf = Vec::new();
     let _ = std::io::stdin().lock().read_to_end(&mut buf);
-    String::from_utf8_lossy(&buf).into_owned()
+    String::from_utf8(buf)
+        .unwrap_or_else(|e| String::from_utf8_lossy(e.as_bytes()).into_owned())
+}
+
+/// Parse the hook payload. Returns empty fields if the JSON is invalid.
+pub fn parse_payload(json: &str) -> HookPayload<'_> {
+    serde_json::from_str(json).unwrap_or_default()
+}
+
+/// Session id and prompt preview captured by `read_save_payload`.
+pub struct SavePayload {
+    pub session_id: String,
+    pub prompt: String,
+}
+
+const MAX_SESSION_ID_CHARS: usize = 256;
+const MAX_KEY_CHARS: usize = 64;
+const SCAN_BUF_SIZE: usize = 8192;
+
+/// Stream the UserPromptSubmit payload from stdin, keeping at most
+/// `prompt_chars` characters of the prompt. Memory stays bounded whatever
+/// the prompt size; the rest of stdin is drained and discarded so the
+/// writer never sees a broken pipe.
+pub fn read_save_payload(prompt_chars: usize) -> SavePayload {
+    let stdin = std::io::stdin();
+    let mut scanner = Scanner::new(stdin.lock());
+    let mut payload = SavePayload {
+        session_id: String::new(),
+        prompt: String::new(),
+    };
+
+    let parsed = scanner.scan_object(|key, scanner| {
+        match key {
+            "session_id" => payload.session_id = scanner.string_field(MAX_SESSION_ID_CHARS)?,
+            "prompt" => payload.prompt = scanner.string_field(prompt_chars)?,
+            _ => scanner.skip_value()?,
+        }
+        Some(())
+    });
+    if parsed.is_none() {
+        crate::debug_log!("Malformed hook payload");
+    }
+
+    scanner.drain();
+    payload
+}
+
+/// A hook payload received by the relay listener. `hook_event_name` tells
+/// which hook ran on the remote machine.
+pub struct RelayEvent {
+    pub hook_event_name: String,
+    pub session_id: String,
+    pub message: String,
+    pub prompt: String,
 }
 
-/// Extract a string field from a JSON string.
-/// Returns empty string if the field is not found or not a string.
-pub fn extract_string(json: &str, key: &str) -> String {
-    let v: serde_json::Value = match serde_json::from_str(json) {
-        Ok(v) => v,
-        Err(_) => return String::new(),
+const MAX_MESSAGE_CHARS: usize = 1024;
+
+/// Relay events streamed from a connection, one hook payload per line.
+/// Like `read_save_payload`, only a bounded preview of each field is kept,
+/// so a line of any length is read in constant memory.
+pub struct RelayStream<R: Read> {
+    scanner: Scanner<R>,
+}
+
+impl<R: Read> RelayStream<R> {
+    pub fn new(inner: R) -> Self {
+        Self { scanner: Scanner::new(inner) }
+    }
+
+    /// Read the next line, keeping at most `prompt_chars` characters of the
+    /// prompt. Returns None at the end of the input, Some(None) for a
+    /// malformed line. Blank lines (heartbeats) are skipped, and so is
+    /// anything after the object on its line.
+    pub fn next_event(&mut self, prompt_chars: usize) -> Option<Option<RelayEvent>> {
+        self.scanner.skip_ws()?;
+        let event = read_relay_event(&mut self.scanner, prompt_chars);
+        self.scanner.skip_line();
+        Some(event)
+    }
+}
+
+fn read_relay_event<R: Read>(scanner: &mut Scanner<R>, prompt_chars: usize) -> Option<RelayEvent> {
+    let mut event = RelayEvent {
+        hook_event_name: String::new(),
+        session_id: String::new(),
+        message: String::new(),
+        prompt: String::new(),
     };
-    v.get(key)
-        .and_then(|v| v.as_str())
-        .unwrap_or("")
-        .to_string()
+
+    scanner.scan_object(|key, scanner| {
+        match key {
+            "hook_event_name" => event.hook_event_name = scanner.string_field(MAX_KEY_CHARS)?,
+            "session_id" => event.session_id = scanner.string_field(MAX_SESSION_ID_CHARS)?,
+            "message" => event.message = scanner.string_field(MAX_MESSAGE_CHARS)?,
+            "prompt" => event.prompt = scanner.string_field(prompt_chars)?,
+            _ => scanner.skip_value()?,
+        }
+        Some(())
+    })?;
+    Some(event)
+}
+
+/// The character for a one-letter escape (`\n`, `\"`, ...).
+fn simple_escape(b: u8) -> Option<char> {
+    Some(match b {
+        b'"' => '"',
+        b'\\' => '\\',
+        b'/' => '/',
+        b'b' => '\u{08}',
+        b'f' => '\u{0C}',
+        b'n' => '\n',
+        b'r' => '\r',
+        b't' => '\t',
+        _ => return None,
+    })
+}
+
+/// Minimal streaming JSON scanner over a buffered reader.
+/// Only understands what the hook payload needs: one top-level object,
+/// string fields kept up to a character limit, everything else skipped.
+struct Scanner<R: Read> {
+    inner: R,
+    buf: Vec<u8>,
+    pos: usize,
+    len: usize,
+}
+
+impl<R: Read> Scanner<R> {
+    fn new(inner: R) -> Self {
+        Self { inner, buf: vec![0; SCAN_BUF_SIZE], pos: 0, len: 0 }
+    }
+
+    fn peek(&mut self) -> Option<u8> {
+        if self.pos == self.len {
+            self.len = loop {
+                match self.inner.read(&mut self.buf) {
+                    Ok(n) => break n,
+                    Err(e) if e.kind() == std::io::ErrorKind::Interrupted => continue,
+                    Err(_) => break 0,
+                }
+            };
+            self.pos = 0;
+            if self.len == 0 {
+                return None;
+            }
+        }
+        Some(self.buf[self.pos])
+    }
+
+    fn next(&mut self) -> Option<u8> {
+        let b = self.peek()?;
+        self.pos += 1;
+        Some(b)
+    }
+
+    /// Next byte of a string. JSON strings cannot hold a raw newline, so one
+    /// ends the string as malformed, and is left for the next line.
+    fn next_in_string(&mut self) -> Option<u8> {
+        if self.peek()? == b'\n' {
+            return None;
+        }
+        self.next()
+    }
+
+    /// Skip whitespace and return (without consuming) the next byte.
+    fn skip_ws(&mut self) -> Option<u8> {
+        loop {
+            let b = self.peek()?;
+            if !matches!(b, b' ' | b'\t' | b'\r' | b'\n') {
+                return Some(b);
+            }
+            self.pos += 1;
+        }
+    }
+
+    fn expect(&mut self, want: u8) -> Option<()> {
+        if self.skip_ws()? != want {
+            return None;
+        }
+        self.pos += 1;
+        Some(())
+    }
+
+    /// Read and discard everything up to and including the next newline.
+    fn skip_line(&mut self) {
+        while let Some(b) = self.next() {
+            if b == b'\n' {
+                break;
+            }
+        }
+    }
+
+    /// Read and discard the rest of the input.
+    fn drain(&mut self) {
+        loop {
+            self.pos = self.len;
+            if self.peek().is_none() {
+                break;
+            }
+        }
+    }
+
+    /// Walk a top-level object, calling `on_field` with each key while the
+    /// scanner is positioned at that key's value.
+    fn scan_object(&mut self, mut on_field: impl FnMut(&str, &mut Self) -> Option<()>) -> Option<()> {
+        self.expect(b'{')?;
+        if self.skip_ws()? == b'}' {
+            self.pos += 1;
+            return Some(());
+        }
+        loop {
+            self.expect(b'"')?;
+            let key = self.read_string(MAX_KEY_CHARS)?;
+            self.expect(b':')?;
+            on_field(&key, self)?;
+            match self.skip_ws()? {
+                b',' => self.pos += 1,
+                b'}' => {
+                    self.pos += 1;
+                    return Some(());
+                }
+                _ => return None,
+            }
+        }
+    }
+
+    /// Read a string value (keeping `max_chars` characters), or skip a
+    /// non-string value and return an empty string.
+    fn string_field(&mut self, max_chars: usize) -> Option<String> {
+        if self.skip_ws()? == b'"' {
+            self.pos += 1;
+            self.read_string(max_chars)
+        } else {
+            self.skip_value()?;
+            Some(String::new())
+        }
+    }
+
+    /// Decode a string whose opening quote was already consumed.
+    /// Characters past `max_chars` are consumed but not kept.
+    fn read_string(&mut self, max_chars: usize) -> Option<String> {
+        let mut out = Vec::new();
+        let mut chars = 0usize;
+        loop {
+            match self.next_in_string()? {
+                b'"' => break,
+                b'\\' => self.read_escape(&mut |c| {
+                    chars += 1;
+                    if chars <= max_chars {
+                        let mut tmp = [0u8; 4];
+                        out.extend_from_slice(c.encode_utf8(&mut tmp).as_bytes());
+                    }
+                })?,
+                b => {
+                    // Count a character at each UTF-8 lead byte
+                    if b & 0xC0 != 0x80 {
+                        chars += 1;
+                    }
+                    if chars <= max_chars {
+                        out.push(b);
+                    }
+                }
+            }
+        }
+        Some(String::from_utf8_lossy(&out).into_owned())
+    }
+
+    /// Decode an escape whose backslash was already consumed, passing the
+    /// resulting characters to `push`. A surrogate that is not part of a
+    /// pair becomes U+FFFD; the escape after a lone high surrogate is still
+    /// decoded on its own.
+    fn read_escape(&mut self, push: &mut impl FnMut(char)) -> Option<()> {
+        let b = self.next_in_string()?;
+        if b != b'u' {
+            push(simple_escape(b)?);
+            return Some(());
+        }
+        let hi = self.read_hex4()?;
+        if !(0xD800..0xDC00).contains(&hi) {
+            push(char::from_u32(hi).unwrap_or('\u{FFFD}'));
+            return Some(());
+        }
+        if self.peek()? != b'\\' {
+            // Lone high surrogate
+            push('\u{FFFD}');
+            return Some(());
+        }
+        self.pos += 1;
+        let b = self.next_in_string()?;
+        if b != b'u' {
+            push('\u{FFFD}');
+            push(simple_escape(b)?);
+            return Some(());
+        }
+        let lo = self.read_hex4()?;
+        if (0xDC00..0xE000).contains(&lo) {
+            push(char::from_u32(0x10000 + ((hi - 0xD800) << 10) + (lo - 0xDC00)).unwrap_or('\u{FFFD}'));
+        } else {
+            push('\u{FFFD}');
+            push(char::from_u32(lo).unwrap_or('\u{FFFD}'));
+        }
+        Some(())
+    }
+
+    fn read_hex4(&mut self) -> Option<u32> {
+        let mut val = 0u32;
+        for _ in 0..4 {
+            let digit = (self.next_in_string()? as char).to_digit(16)?;
+            val = val * 16 + digit;
+        }
+        Some(val)
+    }
+
+    fn skip_string(&mut self) -> Option<()> {
+        loop {
+            match self.next_in_string()? {
+                b'"' => return Some(()),
+                b'\\' => {
+                    self.next()?;
+                }
+                _ => {}
+            }
+        }
+    }
+
+    fn skip_value(&mut self) -> Option<()> {
+        match self.skip_ws()? {
+            b'"' => {
+                self.pos += 1;
+                self.skip_string()
+            }
+            b'{' | b'[' => {
+                let mut depth = 0usize;
+                loop {
+                    match self.next()? {
+                        b'"' => self.skip_string()?,
+                        b'{' | b'[' => depth += 1,
+                        b'}' | b']' => {
+                            depth -= 1;
+                            if depth == 0 {
+                                return Some(());
+                            }
+                        }
+                        _ => {}
+                    }
+                }
+            }
+            _ => {
+                // Number, true, false or null
+                while let Some(b) = self.peek() {
+                    if matches!(b, b',' | b'}' | b']' | b' ' | b'\t' | b'\r' | b'\n') {
+                        break;
+                    }
+                    self.pos += 1;
+                }
+                Some(())
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Hands out one byte per read, so every token crosses a refill.
+    struct Trickle<'a>(&'a [u8]);
+
+    impl Read for Trickle<'_> {
+        fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+            match self.0.split_first() {
+                Some((&b, rest)) if !buf.is_empty() => {
+                    buf[0] = b;
+                    self.0 = rest;
+                    Ok(1)
+                }
+                _ => Ok(0),
+            }
+        }
+    }
+
+    fn parse_relay_event(line: &[u8], prompt_chars: usize) -> Option<RelayEvent> {
+        RelayStream::new(line).next_event(prompt_chars).flatten()
+    }
+
+    /// The value of the single string field of `{"k": <value>}`.
+    fn decode(value: &str, max_chars: usize) -> Option<String> {
+        let input = format!("{{\"k\":{}}}", value);
+        let mut result = None;
+        Scanner::new(Trickle(input.as_bytes())).scan_object(|_, scanner| {
+            result = Some(scanner.string_field(max_chars)?);
+            Some(())
+        })?;
+        result
+    }
+
+    #[test]
+    fn decodes_escapes() {
+        assert_eq!(decode(r#""a\"b\\c\/d""#, 64).as_deref(), Some("a\"b\\c/d"));
+        assert_eq!(decode(r#""\b\f\n\r\t""#, 64).as_deref(), Some("\u{08}\u{0C}\n\r\t"));
+        assert_eq!(decode(r#""café 中""#, 64).as_deref(), Some("café 中"));
+        assert_eq!(decode(r#""\x""#, 64), None);
+        assert_eq!(decode(r#""\u12g4""#, 64), None);
+    }
+
+    #[test]
+    fn decodes_surrogate_pairs() {
+        assert_eq!(decode(r#""\ud83d\ude00!""#, 64).as_deref(), Some("😀!"));
+        assert_eq!(decode(r#""\uD83D\uDE00""#, 64).as_deref(), Some("😀"));
+    }
+
+    #[test]
+    fn lone_surrogates_become_replacement_characters() {
+        assert_eq!(decode(r#""\ud83dx""#, 64).as_deref(), Some("\u{FFFD}x"));
+        assert_eq!(decode(r#""\ud83d""#, 64).as_deref(), Some("\u{FFFD}"));
+        assert_eq!(decode(r#""\ud83d\n""#, 64).as_deref(), Some("\u{FFFD}\n"));
+        assert_eq!(decode(r#""\ud83d\u0041""#, 64).as_deref(), Some("\u{FFFD}A"));
+        assert_eq!(decode(r#""\ude00x""#, 64).as_deref(), Some("\u{FFFD}x"));
+    }
+
+    #[test]
+    fn truncates_on_character_boundaries() {
+        assert_eq!(decode(r#""aé😀b""#, 1).as_deref(), Some("a"));
+        assert_eq!(decode(r#""aé😀b""#, 2).as_deref(), Some("aé"));
+        assert_eq!(decode(r#""aé😀b""#, 3).as_deref(), Some("aé😀"));
+        assert_eq!(decode(r#""aé😀b""#, 0).as_deref(), Some(""));
+        // Escapes count as the characters they decode to
+        assert_eq!(decode(r#""\ud83d\ude00\u00e9x""#, 2).as_deref(), Some("😀é"));
+    }
+
+    #[test]
+    fn non_string_values_read_as_empty() {
+        for value in ["123", "-1.5e3", "true", "null", "[1,2]", r#"{"a":"b"}"#] {
+            assert_eq!(decode(value, 64).as_deref(), Some(""), "{}", value);
+        }
+    }
+
+    #[test]
+    fn skips_nested_values() {
+        let line = br#"{"tool":{"a":[1,{"b":"}]"}],"c":"\"]"},"list":[[],[{}]],"n":-2,
+            "hook_event_name":"Stop","session_id":"s1","message":"done"}"#;
+        let event = parse_relay_event(line, 64).unwrap();
+        assert_eq!(event.hook_event_name, "Stop");
+        assert_eq!(event.session_id, "s1");
+        assert_eq!(event.message, "done");
+        assert_eq!(event.prompt, "");
+    }
+
+    #[test]
+    fn relay_event_keeps_prompt_budget() {
+        let line = br#"{"hook_event_name":"UserPromptSubmit","session_id":"s","prompt":"abcdef"}"#;
+        assert_eq!(parse_relay_event(line, 3).unwrap().prompt, "abc");
+    }
+
+    #[test]
+    fn truncated_input_is_rejected() {
+        let line = r#"{"hook_event_name":"Notification","session_id":"sé","n":12,"x":[{"y":null}],"message":"😀"}"#
+            .as_bytes();
+        assert!(parse_relay_event(line, 64).is_some());
+        for end in 0..line.len() {
+            assert!(parse_relay_event(&line[..end], 64).is_none(), "prefix of {} bytes", end);
+        }
+    }
+
+    #[test]
+    fn malformed_input_is_rejected() {
+        let inputs: &[&[u8]] = &[
+            b"",
+            b"   ",
+            b"[]",
+            b"\"session_id\"",
+            br#"{"session_id" "s"}"#,
+            br#"{"session_id":"s",}"#,
+            br#"{"session_id":"s" "message":"m"}"#,
+            br#"{session_id:"s"}"#,
+            br#"{"session_id":"s\q"}"#,
+            br#"{"session_id":"\u12"}"#,
+        ];
+        for input in inputs {
+            assert!(parse_relay_event(input, 64).is_none(), "{}", String::from_utf8_lossy(input));
+        }
+        assert!(parse_relay_event(b"{}", 64).is_some());
+        assert!(parse_relay_event(b" { } ", 64).is_some());
+    }
+
+    #[test]
+    fn relay_stream_reads_line_after_line() {
+        let input = concat!(
+            "{\"hook_event_name\":\"Stop\",\"session_id\":\"a\"}\n",
+            "\n",
+            "   \r\n",
+            "{\"hook_event_name\":\"Notification\",\"session_id\":\"b\"} trailing junk\n",
+            "{\"session_id\":\"broken\n",
+            "{\"session_id\": [1, 2\n",
+            "]}\n",
+            "{\"hook_event_name\":\"SessionEnd\",\"session_id\":\"c\"}",
+        );
+        let mut stream = RelayStream::new(Trickle(input.as_bytes()));
+        let mut seen = Vec::new();
+        while let Some(event) = stream.next_event(64) {
+            seen.push(event.map(|e| (e.hook_event_name, e.session_id)));
+        }
+        let pair = |name: &str, id: &str| Some((name.to_string(), id.to_string()));
+        assert_eq!(
+            seen,
+            vec![
+                pair("Stop", "a"),
+                pair("Notification", "b"),
+                None,
+                // A value may span lines; the object still parses
+                Some((String::new(), String::new())),
+                pair("SessionEnd", "c"),
+            ]
+        );
+    }
+
+    #[test]
+    fn relay_stream_keeps_a_preview_of_an_oversized_prompt() {
+        let prompt = "x".repeat(1024 * 1024);
+        let input = format!(
+            "{{\"hook_event_name\":\"UserPromptSubmit\",\"session_id\":\"a\",\"prompt\":\"{}\"}}\n\
+             {{\"hook_event_name\":\"Stop\",\"session_id\":\"a\"}}\n",
+            prompt
+        );
+        let mut stream = RelayStream::new(input.as_bytes());
+        let first = stream.next_event(100).unwrap().unwrap();
+        assert_eq!(first.hook_event_name, "UserPromptSubmit");
+        assert_eq!(first.prompt.len(), 100);
+        assert_eq!(stream.next_event(100).unwrap().unwrap().hook_event_name, "Stop");
+        assert!(stream.next_event(100).is_none());
+    }
 }
@@ -1,58 +1,209 @@
 //! Debug logging system.
 //!
-//! When --debug is active, logs to stdout and to <exe_dir>\debug.log.
+//! When --debug is active, lines go to an in-process ring buffer and a
+//! background writer appends them to <exe_dir>\debug.log, so logging never
+//! blocks on the file. Past MAX_LOG_BYTES the file is renamed to
+//! debug.log.1 (replacing the previous one) and a new one is started.
+//! Call `flush` before exiting. Each line carries a
+//! QPC timestamp in microseconds (comparable across processes) and the PID:
+//!
+//! ```text
+//! [   123456789.012] [4242] [DEBUG] Session ID: ...
+//! [   123456789.530] [4242] [SPAN] uia: 0.518 ms
+//! ```
+
+use std::collections::VecDeque;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Condvar, Mutex, OnceLock};
+use std::time::Duration;
 
-use std::sync::OnceLock;
-use std::sync::Mutex;
+use windows::Win32::System::Performance::{QueryPerformanceCounter, QueryPerformanceFrequency};
+
+/// Lines kept before the oldest are dropped.
+const RING_CAPACITY: usize = 4096;
+/// Longest time a line waits in the buffer before the writer picks it up.
+const WRITER_INTERVAL: Duration = Duration::from_millis(250);
+/// Size at which debug.log is rotated to debug.log.1.
+const MAX_LOG_BYTES: u64 = 1024 * 1024;
+
+struct Ring {
+    lines: VecDeque<String>,
+    dropped: usize,
+}
 
 struct Logger {
-    debug: bool,
-    log_path: Option<std::path::PathBuf>,
+    log_path: std::path::PathBuf,
+    ring: Mutex<Ring>,
+    wake: Condvar,
+    /// Held while writing so `flush` and the writer never interleave.
+    file: Mutex<()>,
 }
 
-static LOGGER: OnceLock<Mutex<Logger>> = OnceLock::new();
+static ENABLED: AtomicBool = AtomicBool::new(false);
+static LOGGER: OnceLock<Logger> = OnceLock::new();
+static QPC_FREQUENCY: OnceLock<i64> = OnceLock::new();
 
 /// Initialize the logger. Call once at startup.
 pub fn init(debug: bool) {
-    let log_path = if debug {
-        let exe = std::env::current_exe().unwrap_or_default();
-        let dir = exe.parent().unwrap_or(std::path::Path::new("."));
-        let path = dir.join("debug.log");
-        // Create/truncate with header
-        let _ = std::fs::write(&path, "=== ToastWindow Debug Log ===\n");
-        Some(path)
-    } else {
-        None
+    if !debug {
+        return;
+    }
+
+    let exe = std::env::current_exe().unwrap_or_default();
+    let dir = exe.parent().unwrap_or(std::path::Path::new("."));
+    let logger = Logger {
+        log_path: dir.join("debug.log"),
+        ring: Mutex::new(Ring { lines: VecDeque::new(), dropped: 0 }),
+        wake: Condvar::new(),
+        file: Mutex::new(()),
     };
+    if LOGGER.set(logger).is_err() {
+        return;
+    }
+    ENABLED.store(true, Ordering::SeqCst);
+
+    // Appended, not truncated: concurrent hook processes share the file
+    log_line("INFO", &format!("=== ToastWindow Debug Log ({}) ===", exe.display()));
+
+    let _ = std::thread::Builder::new()
+        .name("log-writer".to_string())
+        .spawn(run_writer);
+}
 
-    let _ = LOGGER.set(Mutex::new(Logger { debug, log_path }));
+/// Whether --debug logging is on. Lets callers skip formatting entirely.
+pub fn enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
 }
 
 /// Log a message. Only outputs if --debug was specified.
 pub fn log(msg: &str) {
-    let Some(logger) = LOGGER.get() else { return };
-    let Ok(logger) = logger.lock() else { return };
+    log_line("DEBUG", msg);
+}
 
-    if !logger.debug && logger.log_path.is_none() {
-        return;
-    }
+fn log_line(tag: &str, msg: &str) {
+    let Some(logger) = LOGGER.get() else { return };
 
     // Debug output goes ONLY to the log file, never to stdout/console.
     // AllocConsole() would create a visible CMD window for GUI subsystem apps,
     // which is unacceptable for a notification tool.
 
-    if let Some(ref path) = logger.log_path {
-        use std::io::Write;
-        if let Ok(mut f) = std::fs::OpenOptions::new().append(true).open(path) {
-            let _ = writeln!(f, "{}", msg);
+    let line = format!(
+        "[{:>16.3}] [{}] [{}] {}\n",
+        qpc_micros(now_qpc()),
+        std::process::id(),
+        tag,
+        msg
+    );
+
+    let mut ring = logger.ring.lock().unwrap_or_else(|e| e.into_inner());
+    if ring.lines.len() >= RING_CAPACITY {
+        ring.lines.pop_front();
+        ring.dropped += 1;
+    }
+    ring.lines.push_back(line);
+    if ring.lines.len() >= RING_CAPACITY / 2 {
+        logger.wake.notify_one();
+    }
+}
+
+/// Write out everything buffered so far. Call before `std::process::exit`,
+/// which does not give the writer thread a chance to run.
+pub fn flush() {
+    if let Some(logger) = LOGGER.get() {
+        write_pending(logger);
+    }
+}
+
+fn run_writer() {
+    let Some(logger) = LOGGER.get() else { return };
+    loop {
+        {
+            let ring = logger.ring.lock().unwrap_or_else(|e| e.into_inner());
+            let _ = logger.wake.wait_timeout(ring, WRITER_INTERVAL);
+        }
+        write_pending(logger);
+    }
+}
+
+fn write_pending(logger: &Logger) {
+    use std::io::Write;
+
+    let _file = logger.file.lock().unwrap_or_else(|e| e.into_inner());
+    let (lines, dropped) = {
+        let mut ring = logger.ring.lock().unwrap_or_else(|e| e.into_inner());
+        (std::mem::take(&mut ring.lines), std::mem::take(&mut ring.dropped))
+    };
+    if lines.is_empty() && dropped == 0 {
+        return;
+    }
+
+    let mut out = String::with_capacity(lines.iter().map(String::len).sum::<usize>() + 64);
+    if dropped > 0 {
+        out.push_str(&format!(
+            "[{:>16.3}] [{}] [WARN] {} log line(s) dropped\n",
+            qpc_micros(now_qpc()),
+            std::process::id(),
+            dropped
+        ));
+    }
+    for line in &lines {
+        out.push_str(line);
+    }
+
+    // A long-running host or many hook runs would otherwise grow it forever
+    let full = std::fs::metadata(&logger.log_path).is_ok_and(|m| m.len() >= MAX_LOG_BYTES);
+    if full {
+        let _ = std::fs::rename(&logger.log_path, logger.log_path.with_extension("log.1"));
+    }
+    if let Ok(mut f) = std::fs::OpenOptions::new().create(true).append(true).open(&logger.log_path) {
+        let _ = f.write_all(out.as_bytes());
+    }
+}
+
+fn now_qpc() -> i64 {
+    let mut counter = 0i64;
+    unsafe { let _ = QueryPerformanceCounter(&mut counter); }
+    counter
+}
+
+fn qpc_micros(ticks: i64) -> f64 {
+    let frequency = *QPC_FREQUENCY.get_or_init(|| {
+        let mut frequency = 0i64;
+        unsafe { let _ = QueryPerformanceFrequency(&mut frequency); }
+        frequency.max(1)
+    });
+    ticks as f64 * 1_000_000.0 / frequency as f64
+}
+
+/// A named timing span; logs its duration when dropped.
+pub struct Span {
+    name: &'static str,
+    start: i64,
+}
+
+/// Start a span, e.g. `let _span = log::span("uia");`. Costs one QPC read
+/// when logging is on and nothing otherwise.
+pub fn span(name: &'static str) -> Span {
+    Span { name, start: if enabled() { now_qpc() } else { 0 } }
+}
+
+impl Drop for Span {
+    fn drop(&mut self) {
+        if self.start == 0 || !enabled() {
+            return;
         }
+        let elapsed_us = qpc_micros(now_qpc()) - qpc_micros(self.start);
+        log_line("SPAN", &format!("{}: {:.3} ms", self.name, elapsed_us / 1000.0));
     }
 }
 
-/// Convenience macro for formatted logging with [DEBUG] prefix.
+/// Convenience macro for formatted logging. Arguments are not formatted
+/// unless --debug is on.
 #[macro_export]
 macro_rules! debug_log {
     ($($arg:tt)*) => {
-        $crate::log::log(&format!("[DEBUG] {}", format!($($arg)*)))
+        if $crate::log::enabled() {
+            $crate::log::log(&format!($($arg)*))
+        }
     };
 }
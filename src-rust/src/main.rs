@@ -1,11 +1,17 @@
 #![windows_subsystem = "windows"]
 
 mod activate;
+mod animation;
 mod assets;
 mod cli;
+mod etw;
+mod host;
 mod json;
 mod log;
+mod notify;
 mod process;
+mod registry;
+mod relay;
 mod spawn;
 mod state;
 mod toast;
@@ -14,6 +20,7 @@ mod util;
 
 use windows::Win32::Foundation::HWND;
 use windows::Win32::System::Com::*;
+use windows::Win32::UI::HiDpi::{SetProcessDpiAwarenessContext, DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2};
 use windows::Win32::UI::WindowsAndMessaging::*;
 
 fn print_usage() {
@@ -23,23 +30,29 @@ fn print_usage() {
     println!(
         "Usage:\n  \
          ToastWindow.exe --save      Save window state (UserPromptSubmit hook)\n  \
+         ToastWindow.exe --save --defer  Save now, resolve tab and icon in the background\n  \
          ToastWindow.exe --notify    Show notification (Stop hook)\n  \
-         ToastWindow.exe --input     Show input-required notification (Notification hook)\n\n\
+         ToastWindow.exe --input     Show input-required notification (Notification hook)\n  \
+         ToastWindow.exe --host      Run the toast host (started automatically)\n  \
+         ToastWindow.exe --host --relay [addr]  Run the host and accept relayed hook events\n\n\
+         Flags:\n  \
+         --relay [addr]       Listen address: port, :port or host:port (default 127.0.0.1:9417)\n  \
+         --batch-ms <n>       Merge notification bursts within n ms (default 250, 0 = off)\n  \
+         --preview-chars <n>  Prompt characters kept beyond the display (default 64)\n  \
+         --stdin-request      Read the request as JSON from stdin (set when a host is spawned)\n  \
+         --debug, -d          Write debug.log\n\n\
          Both modes read session_id from stdin JSON for state file isolation."
     );
 }
 
-fn exe_path() -> String {
-    std::env::current_exe()
-        .unwrap_or_default()
-        .to_string_lossy()
-        .into_owned()
-}
-
-fn run_save_mode(immediate_hwnd: HWND) -> i32 {
-    let input = json::read_stdin_json();
-    let session_id = json::extract_string(&input, "session_id");
-    let prompt = json::extract_string(&input, "prompt");
+fn run_save_mode(immediate_hwnd: HWND, args: &cli::Args) -> i32 {
+    // Keep one character past the display limit so the toast still knows
+    // to append "...", plus the configured preview budget.
+    let payload = {
+        let _span = log::span("stdin read");
+        json::read_save_payload(notify::DISPLAY_CHARS + 1 + args.preview_chars)
+    };
+    let session_id = payload.session_id;
 
     if session_id.is_empty() {
         debug_log!("No session_id, skipping save");
@@ -47,7 +60,7 @@ fn run_save_mode(immediate_hwnd: HWND) -> i32 {
     }
 
     debug_log!("Session ID: {}", session_id);
-    debug_log!("Prompt: {}", prompt);
+    debug_log!("Prompt preview: {}", payload.prompt);
 
     // Use immediate_hwnd, fall back to GetForegroundWindow if invalid (SPEC 3.2)
     let hwnd = if !immediate_hwnd.is_invalid()
@@ -62,31 +75,99 @@ fn run_save_mode(immediate_hwnd: HWND) -> i32 {
         fallback
     };
 
-    // Detect Windows Terminal and get RuntimeId
-    let mut runtime_id = String::new();
     let class = util::get_class_name(hwnd);
     debug_log!("Window class: {}", class);
 
-    if class == "CASCADIA_HOSTING_WINDOW_CLASS" {
+    // The caller does not change within a session, so reuse the path
+    // resolved by an earlier prompt. Otherwise walk the parent chain here:
+    // it only stays intact while the hook is running.
+    let mut icon_path = state::load_state(&session_id).icon_path;
+    if icon_path.is_empty() {
+        icon_path = process::find_caller_exe_path();
+        debug_log!("Caller exe path: {}", icon_path);
+    } else {
+        debug_log!("Caller exe path (cached): {}", icon_path);
+    }
+
+    let mut st = state::State {
+        target_hwnd: hwnd,
+        window_class: class,
+        icon_path,
+        user_prompt: payload.prompt,
+        saved_at: state::now_stamp(),
+        ..Default::default()
+    };
+
+    if args.defer && st.window_class == state::WT_CLASS_NAME {
+        // Save what is known now and leave the UIA tab lookup to a detached
+        // worker, so the prompt is not held up by it. The worker reads the
+        // tab selected a moment after the prompt was submitted; switching
+        // tabs within that moment records the new tab instead.
+        state::save_state(&session_id, &st);
+        let mut cmd = format!(
+            "\"{}\" --resolve --session \"{}\" --stamp {}",
+            util::exe_path(),
+            session_id,
+            st.saved_at
+        );
+        if args.debug {
+            cmd.push_str(" --debug");
+        }
+        debug_log!("Deferring capture: {}", cmd);
+        if spawn::spawn_detached(&cmd) {
+            return 0;
+        }
+        debug_log!("Resolver spawn failed, capturing inline");
+    }
+
+    capture_tab(&mut st);
+    state::save_state(&session_id, &st);
+    debug_log!("State saved for session {}", session_id);
+
+    0
+}
+
+/// Fill in the Windows Terminal tab RuntimeId.
+fn capture_tab(st: &mut state::State) {
+    if st.window_class == state::WT_CLASS_NAME {
         debug_log!("Detected Windows Terminal, capturing tab RuntimeId");
-        runtime_id = uiautomation::get_selected_tab_runtime_id(hwnd);
-        debug_log!("RuntimeId: {}", runtime_id);
+        st.wt_runtime_id = uiautomation::get_selected_tab_runtime_id(st.target_hwnd);
+        debug_log!("RuntimeId: {}", st.wt_runtime_id);
     }
+}
 
-    // Find caller exe path for icon extraction
-    let caller_path = process::find_caller_exe_path();
-    debug_log!("Caller exe path: {}", caller_path);
+/// Complete a record saved by `--save --defer` with the tab RuntimeId.
+/// The caller exe path was already resolved by the hook.
+fn run_resolve_mode(args: &cli::Args) -> i32 {
+    if args.session.is_empty() {
+        debug_log!("No session ID for resolve mode");
+        return 1;
+    }
+
+    let mut st = state::load_state(&args.session);
+    if st.saved_at != args.stamp {
+        debug_log!("State superseded before resolve, skipping");
+        return 0;
+    }
 
-    // Save state
-    state::save_state(&session_id, hwnd, &runtime_id, &caller_path, &prompt);
-    debug_log!("State saved to {:?}", state::state_file_path(&session_id));
+    capture_tab(&mut st);
+
+    // A newer prompt may have been saved while resolving
+    if !state::save_state_if(&args.session, &st, Some(args.stamp)) {
+        debug_log!("State superseded during resolve, discarding");
+        return 0;
+    }
+    debug_log!("Deferred state saved for session {}", args.session);
 
     0
 }
 
-fn run_notify_mode(debug: bool) -> i32 {
-    let input = json::read_stdin_json();
-    let session_id = json::extract_string(&input, "session_id");
+fn run_notify_mode(args: &cli::Args) -> i32 {
+    let input = {
+        let _span = log::span("stdin read");
+        json::read_stdin_json()
+    };
+    let session_id = json::parse_payload(&input).session_id;
 
     if session_id.is_empty() {
         debug_log!("No session_id for notify mode");
@@ -95,20 +176,24 @@ fn run_notify_mode(debug: bool) -> i32 {
 
     debug_log!("Notify mode, session: {}", session_id);
 
-    let mut cmd = format!("\"{}\" --notify-show --session \"{}\"", exe_path(), session_id);
-    if debug {
-        cmd.push_str(" --debug");
-    }
-
-    debug_log!("Spawning: {}", cmd);
-    spawn::spawn_detached(&cmd);
+    let req = notify::Request {
+        session: session_id.into_owned(),
+        input_mode: false,
+        message: String::new(),
+        count: 1,
+    };
+    host::dispatch(&req, args);
     0
 }
 
-fn run_input_mode(debug: bool) -> i32 {
-    let input = json::read_stdin_json();
-    let session_id = json::extract_string(&input, "session_id");
-    let message = json::extract_string(&input, "message");
+fn run_input_mode(args: &cli::Args) -> i32 {
+    let input = {
+        let _span = log::span("stdin read");
+        json::read_stdin_json()
+    };
+    let payload = json::parse_payload(&input);
+    let session_id = payload.session_id;
+    let message = payload.message;
 
     if session_id.is_empty() {
         debug_log!("No session_id for input mode");
@@ -117,28 +202,22 @@ fn run_input_mode(debug: bool) -> i32 {
 
     debug_log!("Input mode, session: {}, message: {}", session_id, message);
 
-    let mut cmd = format!(
-        "\"{}\" --notify-show --input-mode --session \"{}\"",
-        exe_path(),
-        session_id
-    );
-    if !message.is_empty() {
-        // Escape quotes in message (SPEC 16.2)
-        let escaped = message.replace('"', "\\\"");
-        cmd.push_str(&format!(" --message \"{}\"", escaped));
-    }
-    if debug {
-        cmd.push_str(" --debug");
-    }
-
-    debug_log!("Spawning: {}", cmd);
-    spawn::spawn_detached(&cmd);
+    let req = notify::Request {
+        session: session_id.into_owned(),
+        input_mode: true,
+        message: message.into_owned(),
+        count: 1,
+    };
+    host::dispatch(&req, args);
     0
 }
 
 fn run_cleanup_mode() -> i32 {
-    let input = json::read_stdin_json();
-    let session_id = json::extract_string(&input, "session_id");
+    let input = {
+        let _span = log::span("stdin read");
+        json::read_stdin_json()
+    };
+    let session_id = json::parse_payload(&input).session_id;
 
     if !session_id.is_empty() {
         debug_log!("Cleanup: deleting state for session {}", session_id);
@@ -148,124 +227,98 @@ fn run_cleanup_mode() -> i32 {
 }
 
 fn run_notify_show_mode(args: &cli::Args) -> i32 {
-    if args.session.is_empty() {
+    let req = request_from_args(args);
+    if req.session.is_empty() {
         debug_log!("No session ID for notify-show mode");
         return 1;
     }
 
-    debug_log!("NotifyShow mode, session: {}", args.session);
-
-    // 1. Load state from file
-    let st = state::load_state(&args.session);
-    debug_log!("Loaded state: HWND={:?}, RuntimeId={}, IconPath={}, Prompt={}",
-        st.target_hwnd, st.wt_runtime_id, st.icon_path, st.user_prompt);
-
-    // 2. Determine notification content (SPEC 14.1-14.2)
-    let (title, message) = if args.input_mode {
-        let msg = if !args.message.is_empty() {
-            args.message.clone()
-        } else {
-            "Claude needs your input".to_string()
-        };
-        ("Input Required".to_string(), msg)
-    } else {
-        let msg = if !st.user_prompt.is_empty() {
-            st.user_prompt.clone()
-        } else {
-            "Task completed".to_string()
-        };
-        ("Claude Code".to_string(), msg)
-    };
-
-    // 3. Sanitize message (SPEC 14.3)
-    let message = sanitize_message(&message);
-    debug_log!("Title: {}, Message: {}", title, message);
-
-    // 4. Discover assets
-    let discovered = assets::discover_assets();
-    debug_log!("Sound: {:?}, Font: {:?}, Icon: {:?}",
-        discovered.sound_file, discovered.font_file, discovered.default_icon_path);
-
-    // 5. Extract icon from saved exe path
-    let icon = assets::extract_icon(&st.icon_path);
-    debug_log!("App icon: {:?}", icon);
+    debug_log!("NotifyShow mode, session: {}", req.session);
 
-    // 6. Load custom font
-    let font_family = if let Some(ref font_path) = discovered.font_file {
-        assets::load_font(font_path).unwrap_or_else(|| "Segoe UI".to_string())
-    } else {
-        "Segoe UI".to_string()
-    };
-    debug_log!("Font family: {}", font_family);
-
-    // 7. Play sound
-    assets::play_sound(&discovered.sound_file);
-
-    // 8. Show toast (blocks until closed)
-    toast::show_toast(toast::ToastParams {
-        title,
-        message,
-        input_mode: args.input_mode,
-        font_family,
-        icon,
-        default_icon_path: discovered.default_icon_path.unwrap_or_default(),
-        target_hwnd: st.target_hwnd,
-        wt_hwnd: st.wt_hwnd,
-        wt_runtime_id: st.wt_runtime_id,
-    });
-
-    // 9. Cleanup
-    if !icon.is_invalid() {
-        unsafe { let _ = windows::Win32::UI::WindowsAndMessaging::DestroyIcon(icon); }
-    }
-    if let Some(ref font_path) = discovered.font_file {
-        assets::unload_font(font_path);
-    }
+    let loaded = assets::load_assets();
+    notify::show_notification(&req, &loaded);
+    loaded.release();
+    toast::release_gdi_cache();
 
     0
 }
 
-fn sanitize_message(msg: &str) -> String {
-    // Replace newlines with space
-    let mut s: String = msg.chars().map(|c| {
-        if c == '\n' || c == '\r' { ' ' } else { c }
-    }).collect();
+fn run_host_mode(args: &cli::Args) -> i32 {
+    let req = request_from_args(args);
+    let initial = if req.session.is_empty() { None } else { Some(req) };
+    host::run_host(initial, args.batch_ms, args.relay.as_deref())
+}
 
-    // Truncate at 35 chars + "..."
-    if s.chars().count() > 35 {
-        s = s.chars().take(35).collect::<String>() + "...";
+/// Build the request from --session/--message, or from the JSON the
+/// spawning process wrote to stdin when --stdin-request is set.
+fn request_from_args(args: &cli::Args) -> notify::Request {
+    if args.stdin_request {
+        let input = {
+            let _span = log::span("stdin read");
+            json::read_stdin_json()
+        };
+        return serde_json::from_str(&input).unwrap_or_else(|e| {
+            debug_log!("Invalid request on stdin: {}", e);
+            notify::Request::default()
+        });
+    }
+    notify::Request {
+        session: args.session.clone(),
+        input_mode: args.input_mode,
+        message: args.message.clone(),
+        count: 1,
     }
-    s
 }
 
 fn main() {
     // CRITICAL: Capture foreground window IMMEDIATELY (SPEC 3.1)
     let immediate_hwnd = unsafe { GetForegroundWindow() };
 
+    // Toasts render at the monitor's real DPI instead of being stretched
     unsafe {
-        let hr = CoInitializeEx(None, COINIT_APARTMENTTHREADED);
-        if hr.is_err() {
-            debug_log!("CoInitializeEx failed: {:?}", hr);
-        }
+        let _ = SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
     }
 
     let args = cli::parse_args();
     log::init(args.debug);
 
+    // Notify/Input only hand off to the host and never touch COM
+    let com_initialized = !matches!(
+        args.mode,
+        cli::Mode::Notify | cli::Mode::Input | cli::Mode::Cleanup | cli::Mode::None
+    ) && unsafe {
+        let hr = CoInitializeEx(None, COINIT_APARTMENTTHREADED);
+        if hr.is_err() {
+            debug_log!("CoInitializeEx failed: {:?}", hr);
+        }
+        hr.is_ok()
+    };
+    etw::register();
+    etw_event!("hook enter: {:?}", args.mode);
+
     let exit_code = match args.mode {
-        cli::Mode::Save => run_save_mode(immediate_hwnd),
-        cli::Mode::Notify => run_notify_mode(args.debug),
-        cli::Mode::Input => run_input_mode(args.debug),
+        cli::Mode::Save => run_save_mode(immediate_hwnd, &args),
+        cli::Mode::Resolve => run_resolve_mode(&args),
+        cli::Mode::Notify => run_notify_mode(&args),
+        cli::Mode::Input => run_input_mode(&args),
         cli::Mode::NotifyShow => run_notify_show_mode(&args),
+        cli::Mode::Host => run_host_mode(&args),
         cli::Mode::Cleanup => run_cleanup_mode(),
         cli::Mode::None => {
             print_usage();
             1
         }
     };
+    etw_event!("hook exit: {:?} code={}", args.mode, exit_code);
 
-    unsafe {
-        CoUninitialize();
+    uiautomation::finish_tab_selection();
+    uiautomation::release_automation();
+    if com_initialized {
+        unsafe {
+            CoUninitialize();
+        }
     }
+    log::flush();
+    etw::unregister();
     std::process::exit(exit_code);
 }
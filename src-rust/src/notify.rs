@@ -0,0 +1,124 @@
+//! Notification content and display.
+//!
+//! Turns a notification request (session + mode + optional message) into
+//! a toast, using the saved session state and already-loaded assets.
+//! Shared by the host daemon and the standalone --notify-show mode.
+
+use serde::{Deserialize, Serialize};
+
+use crate::debug_log;
+use crate::{assets, state, toast};
+
+/// Characters of the message shown in the toast before "..." is appended.
+pub const DISPLAY_CHARS: usize = 35;
+
+/// A request to show one notification.
+#[derive(Debug, Clone, Default, Serialize, Deserialize)]
+pub struct Request {
+    pub session: String,
+    pub input_mode: bool,
+    pub message: String,
+    /// Events merged into this request by the host batch window (0 or 1: single).
+    #[serde(default)]
+    pub count: u32,
+}
+
+/// Show the notification for a request. Blocks until the toast is closed.
+pub fn show_notification(req: &Request, assets: &assets::LoadedAssets) {
+    // 1. Load state from file
+    let st = state::load_state(&req.session);
+    debug_log!("Loaded state: HWND={:?}, RuntimeId={}, IconPath={}, Prompt={}",
+        st.target_hwnd, st.wt_runtime_id, st.icon_path, st.user_prompt);
+
+    // 2-3. Title and sanitized message
+    let (title, message) = content(req, &st);
+    debug_log!("Title: {}, Message: {}", title, message);
+
+    // 4. Caller exe icon, pre-scaled and cached across processes
+    let icon = assets::exe_icon(&st.icon_path, toast::icon_size());
+    debug_log!("App icon: {}", if icon.is_some() { "cached bitmap" } else { "none" });
+
+    // 5. Warm up UI Automation now so a click only pays for the tab search
+    if !st.wt_runtime_id.is_empty() {
+        crate::uiautomation::prewarm_tab_worker();
+    }
+
+    // 6. Show toast (blocks until closed); the sound starts as it appears
+    toast::show_toast(toast::ToastParams {
+        title,
+        message,
+        input_mode: req.input_mode,
+        font_family: assets.font_family.clone(),
+        icon,
+        icon_path: st.icon_path,
+        default_icon_path: assets.default_icon_path.clone(),
+        target_hwnd: st.target_hwnd,
+        wt_hwnd: st.wt_hwnd,
+        wt_runtime_id: st.wt_runtime_id,
+        dedup_key: dedup_key(req),
+    });
+}
+
+/// Key under which a request's toast is registered for updates: input
+/// requests per session, completion toasts never merged ("").
+fn dedup_key(req: &Request) -> String {
+    if req.input_mode {
+        format!("input|{}", req.session)
+    } else {
+        String::new()
+    }
+}
+
+/// Show `req` in the session's live input toast instead of a new one.
+/// `applied` runs once the toast shows it (see `toast::update_toast`).
+/// Returns false if there is no such toast.
+pub fn update_notification(req: &Request, applied: impl FnOnce() + Send + 'static) -> bool {
+    let key = dedup_key(req);
+    if key.is_empty() {
+        return false;
+    }
+    let (title, message) = content(req, &state::State::default());
+    debug_log!("Updating live toast: {}, {}", title, message);
+    toast::update_toast(&key, title, message, applied)
+}
+
+/// Toast title and sanitized message for a request (SPEC 14.1-14.3).
+fn content(req: &Request, st: &state::State) -> (String, String) {
+    let (title, message) = if req.input_mode {
+        let msg = if !req.message.is_empty() {
+            req.message.clone()
+        } else {
+            "Claude needs your input".to_string()
+        };
+        ("Input Required".to_string(), msg)
+    } else {
+        let msg = if !st.user_prompt.is_empty() {
+            st.user_prompt.clone()
+        } else {
+            "Task completed".to_string()
+        };
+        ("Claude Code".to_string(), msg)
+    };
+
+    // A merged burst shows how many events it stands for
+    let title = if req.count > 1 {
+        format!("{} ({})", title, req.count)
+    } else {
+        title
+    };
+
+    (title, sanitize_message(&message))
+}
+
+fn sanitize_message(msg: &str) -> String {
+    // Replace newlines with space
+    let mut s: String = msg.chars().map(|c| {
+        if c == '\n' || c == '\r' { ' ' } else { c }
+    }).collect();
+
+    // Truncate at DISPLAY_CHARS chars + "..."
+    if s.chars().count() > DISPLAY_CHARS {
+        s = s.chars().take(DISPLAY_CHARS).collect::<String>() + "...";
+    }
+    s
+}
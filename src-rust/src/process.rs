@@ -3,8 +3,8 @@
 //! Walks up the process tree (max 10 levels) to find the first non-shell process,
 //! which is used to extract an icon for the toast notification.
 
+use windows::Wdk::System::Threading::{NtQueryInformationProcess, ProcessBasicInformation};
 use windows::Win32::Foundation::*;
-use windows::Win32::System::Diagnostics::ToolHelp::*;
 use windows::Win32::System::Threading::*;
 
 /// Shell/runtime processes to skip (exact match, case-insensitive).
@@ -42,96 +42,87 @@ const KNOWN_APPS: &[&str] = &[
 ];
 
 /// Find the caller application's exe path by walking up the process tree.
+///
+/// Each step opens the parent and asks it for its own parent, so no process
+/// snapshot is taken and the walk is cheap enough to run inside the hook,
+/// while the whole chain is still alive.
 pub fn find_caller_exe_path() -> String {
-    let mut pid = unsafe { GetCurrentProcessId() };
-
+    let _span = crate::log::span("process walk");
+    let mut current = Ancestor::this_process();
     for _ in 0..10 {
-        let parent_pid = get_parent_pid(pid);
-        if parent_pid == 0 || parent_pid == pid {
-            break;
-        }
-
-        let exe_path = get_process_exe_path(parent_pid);
-        if exe_path.is_empty() {
-            pid = parent_pid;
-            continue;
-        }
-
+        let Some(parent) = current.parent() else { break };
+        let exe_path = parent.exe_path();
         let exe_name = file_name_without_ext(&exe_path).to_lowercase();
 
-        // Check known apps first (prefix-dash matching)
-        if is_known_app(&exe_name) {
+        // Known app or unknown but valid process - use it if we could read its path
+        if !exe_path.is_empty()
+            && (is_known_app(&exe_name) || !SKIP_LIST.contains(&exe_name.as_str()))
+        {
             return exe_path;
         }
-
-        // Check skip list (exact match)
-        if SKIP_LIST.contains(&exe_name.as_str()) {
-            pid = parent_pid;
-            continue;
-        }
-
-        // Unknown but valid process - use it
-        return exe_path;
+        current = parent;
     }
 
     String::new()
 }
 
-fn is_known_app(exe_name: &str) -> bool {
-    for app in KNOWN_APPS {
-        if exe_name == *app || exe_name.starts_with(&format!("{}-", app)) {
-            return true;
-        }
-    }
-    false
+/// An open handle on one process of the caller chain.
+struct Ancestor {
+    handle: HANDLE,
+    owned: bool,
 }
 
-fn get_parent_pid(pid: u32) -> u32 {
-    unsafe {
-        let snapshot = match CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0) {
-            Ok(h) => h,
-            Err(_) => return 0,
-        };
+impl Ancestor {
+    fn this_process() -> Self {
+        Ancestor { handle: unsafe { GetCurrentProcess() }, owned: false }
+    }
 
-        let mut entry = PROCESSENTRY32W {
-            dwSize: std::mem::size_of::<PROCESSENTRY32W>() as u32,
-            ..Default::default()
+    /// Open this process's parent. Returns None once the parent has exited:
+    /// its pid may then belong to an unrelated process, which shows up as
+    /// one created after its supposed child.
+    fn parent(&self) -> Option<Ancestor> {
+        let mut info = PROCESS_BASIC_INFORMATION::default();
+        let status = unsafe {
+            NtQueryInformationProcess(
+                self.handle,
+                ProcessBasicInformation,
+                &mut info as *mut PROCESS_BASIC_INFORMATION as *mut _,
+                std::mem::size_of::<PROCESS_BASIC_INFORMATION>() as u32,
+                None,
+            )
         };
-
-        if Process32FirstW(snapshot, &mut entry).is_ok() {
-            loop {
-                if entry.th32ProcessID == pid {
-                    let _ = CloseHandle(snapshot);
-                    return entry.th32ParentProcessID;
-                }
-                if Process32NextW(snapshot, &mut entry).is_err() {
-                    break;
-                }
-            }
+        let pid = info.InheritedFromUniqueProcessId as u32;
+        if status.is_err() || pid == 0 || pid == unsafe { GetProcessId(self.handle) } {
+            return None;
         }
 
-        let _ = CloseHandle(snapshot);
-        0
+        let handle = unsafe { OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, pid) }.ok()?;
+        let parent = Ancestor { handle, owned: true };
+        match (parent.created(), self.created()) {
+            (Some(parent_time), Some(child_time)) if parent_time <= child_time => Some(parent),
+            _ => None,
+        }
     }
-}
 
-fn get_process_exe_path(pid: u32) -> String {
-    unsafe {
-        let handle = match OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, pid) {
-            Ok(h) => h,
-            Err(_) => return String::new(),
-        };
+    fn created(&self) -> Option<u64> {
+        let mut created = FILETIME::default();
+        let (mut exited, mut kernel, mut user) =
+            (FILETIME::default(), FILETIME::default(), FILETIME::default());
+        unsafe { GetProcessTimes(self.handle, &mut created, &mut exited, &mut kernel, &mut user) }.ok()?;
+        Some(((created.dwHighDateTime as u64) << 32) | created.dwLowDateTime as u64)
+    }
 
+    fn exe_path(&self) -> String {
         let mut buf = [0u16; 1024];
         let mut size = buf.len() as u32;
-        let result = QueryFullProcessImageNameW(
-            handle,
-            PROCESS_NAME_WIN32,
-            windows::core::PWSTR(buf.as_mut_ptr()),
-            &mut size,
-        );
-        let _ = CloseHandle(handle);
-
+        let result = unsafe {
+            QueryFullProcessImageNameW(
+                self.handle,
+                PROCESS_NAME_WIN32,
+                windows::core::PWSTR(buf.as_mut_ptr()),
+                &mut size,
+            )
+        };
         match result {
             Ok(_) => String::from_utf16_lossy(&buf[..size as usize]),
             Err(_) => String::new(),
@@ -139,6 +130,25 @@ fn get_process_exe_path(pid: u32) -> String {
     }
 }
 
+impl Drop for Ancestor {
+    fn drop(&mut self) {
+        if self.owned {
+            unsafe {
+                let _ = CloseHandle(self.handle);
+            }
+        }
+    }
+}
+
+fn is_known_app(exe_name: &str) -> bool {
+    for app in KNOWN_APPS {
+        if exe_name == *app || exe_name.starts_with(&format!("{}-", app)) {
+            return true;
+        }
+    }
+    false
+}
+
 fn file_name_without_ext(path: &str) -> String {
     let name = path
         .rsplit(|c| c == '\\' || c == '/')
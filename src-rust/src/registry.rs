@@ -0,0 +1,75 @@
+//! Registry of live toasts in this process.
+//!
+//! The host owns every toast, so stacking queries read this table instead
+//! of enumerating every top-level window on the desktop. Entries are kept
+//! in creation order: index 0 is the oldest toast, closest to the taskbar.
+//! A toast may carry a key so a later request can find and update it.
+
+use std::sync::Mutex;
+
+use windows::Win32::Foundation::HWND;
+use windows::Win32::UI::WindowsAndMessaging::IsWindow;
+
+struct Entry {
+    /// Raw window handle, because HWND is not Send
+    hwnd: isize,
+    /// Lookup key for `find`; empty if the toast is never updated
+    key: String,
+}
+
+/// Toasts in creation order.
+static TOASTS: Mutex<Vec<Entry>> = Mutex::new(Vec::new());
+
+fn with_toasts<R>(f: impl FnOnce(&mut Vec<Entry>) -> R) -> R {
+    let mut guard = TOASTS.lock().unwrap_or_else(|e| e.into_inner());
+    f(&mut guard)
+}
+
+/// Add a newly created toast to the top of the stack.
+pub fn register(hwnd: HWND, key: &str) {
+    with_toasts(|toasts| toasts.push(Entry { hwnd: hwnd.0 as isize, key: key.to_string() }));
+}
+
+/// The live toast registered under `key`, if any.
+pub fn find(key: &str) -> Option<HWND> {
+    if key.is_empty() {
+        return None;
+    }
+    with_toasts(|toasts| {
+        toasts
+            .iter()
+            .find(|e| e.key == key && unsafe { IsWindow(Some(HWND(e.hwnd as *mut _))).as_bool() })
+            .map(|e| HWND(e.hwnd as *mut _))
+    })
+}
+
+/// Remove a toast. Safe to call more than once. Also drops entries whose
+/// window is already gone (e.g. its thread died), so ranks stay correct.
+pub fn unregister(hwnd: HWND) {
+    with_toasts(|toasts| {
+        toasts.retain(|e| {
+            e.hwnd != hwnd.0 as isize && unsafe { IsWindow(Some(HWND(e.hwnd as *mut _))).as_bool() }
+        })
+    });
+}
+
+/// All live toasts except `hwnd`, oldest first.
+pub fn others(hwnd: HWND) -> Vec<HWND> {
+    with_toasts(|toasts| {
+        toasts
+            .iter()
+            .filter(|e| e.hwnd != hwnd.0 as isize)
+            .map(|e| HWND(e.hwnd as *mut _))
+            .collect()
+    })
+}
+
+/// Position of `hwnd` in the stack (0 = bottom), or None if not registered.
+pub fn rank(hwnd: HWND) -> Option<usize> {
+    with_toasts(|toasts| toasts.iter().position(|e| e.hwnd == hwnd.0 as isize))
+}
+
+/// Whether `hwnd` is the oldest live toast (the bottom of the stack).
+pub fn is_oldest(hwnd: HWND) -> bool {
+    with_toasts(|toasts| toasts.first().map_or(true, |e| e.hwnd == hwnd.0 as isize))
+}
@@ -0,0 +1,145 @@
+//! Hook event relay for remote and WSL sessions.
+//!
+//! `--host --relay <addr>` makes the host listen on a TCP address for hook
+//! payloads forwarded from machines where ToastWindow.exe cannot reach the
+//! desktop. Framing is one JSON object per line: the unmodified hook
+//! payload, whose `hook_event_name` selects the action:
+//!
+//! ```text
+//! UserPromptSubmit  save the prompt preview for the session
+//! Stop              completion toast
+//! Notification      input-required toast
+//! SessionEnd        delete the session state
+//! ```
+//!
+//! A client may keep one connection open and send events as they happen;
+//! empty lines are heartbeats. A connection that sends nothing for
+//! KEEPALIVE_TIMEOUT is closed. Lines of any length are accepted: like a
+//! local --save, only a preview of each field is kept and the rest of the
+//! line is read past, so a huge pasted prompt still saves its preview.
+//! Toasts go through the host's batch window like local requests.
+//!
+//! Remote sessions have no local window, so their toasts cannot activate
+//! anything when clicked. Bind to loopback (the default when only a port is
+//! given) and reach it through `ssh -R`, unless the network is trusted.
+
+use std::net::{TcpListener, TcpStream};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::time::Duration;
+
+use crate::debug_log;
+use crate::notify::{self, Request};
+use crate::{cli, host, json, state};
+
+/// Port used when `--relay` is given without one.
+pub const DEFAULT_PORT: u16 = 9417;
+
+/// Close a connection after this long without data (heartbeats included).
+const KEEPALIVE_TIMEOUT: Duration = Duration::from_secs(120);
+/// Concurrent connections served; further ones are closed immediately.
+const MAX_CONNECTIONS: usize = 16;
+
+static CONNECTIONS: AtomicUsize = AtomicUsize::new(0);
+
+/// Resolve `--relay` to a socket address: "9417", ":9417", "0.0.0.0:9417".
+fn listen_addr(spec: &str) -> String {
+    let spec = spec.trim();
+    if spec.is_empty() {
+        format!("127.0.0.1:{}", DEFAULT_PORT)
+    } else if let Some(port) = spec.strip_prefix(':') {
+        format!("127.0.0.1:{}", port)
+    } else if spec.parse::<u16>().is_ok() {
+        format!("127.0.0.1:{}", spec)
+    } else {
+        spec.to_string()
+    }
+}
+
+/// Bind the listener and serve it on a background thread.
+/// Returns false if the address could not be bound.
+pub fn start(spec: &str) -> bool {
+    let addr = listen_addr(spec);
+    let listener = match TcpListener::bind(&addr) {
+        Ok(l) => l,
+        Err(e) => {
+            debug_log!("Relay bind {} failed: {}", addr, e);
+            return false;
+        }
+    };
+    debug_log!("Relay listening on {}", addr);
+
+    std::thread::Builder::new()
+        .name("relay".to_string())
+        .spawn(move || accept_loop(listener))
+        .is_ok()
+}
+
+fn accept_loop(listener: TcpListener) {
+    for stream in listener.incoming() {
+        let Ok(stream) = stream else { continue };
+        if CONNECTIONS.fetch_add(1, Ordering::SeqCst) >= MAX_CONNECTIONS {
+            CONNECTIONS.fetch_sub(1, Ordering::SeqCst);
+            debug_log!("Relay connection refused: limit reached");
+            continue;
+        }
+        let spawned = std::thread::Builder::new()
+            .name("relay-conn".to_string())
+            .spawn(move || {
+                serve_connection(stream);
+                CONNECTIONS.fetch_sub(1, Ordering::SeqCst);
+            });
+        if spawned.is_err() {
+            CONNECTIONS.fetch_sub(1, Ordering::SeqCst);
+        }
+    }
+}
+
+fn serve_connection(stream: TcpStream) {
+    let peer = stream.peer_addr().map(|a| a.to_string()).unwrap_or_default();
+    debug_log!("Relay connection from {}", peer);
+    // A read error, including the keep-alive timeout, ends the stream
+    let _ = stream.set_read_timeout(Some(KEEPALIVE_TIMEOUT));
+
+    // Same preview budget as a local --save
+    let prompt_chars = notify::DISPLAY_CHARS + 1 + cli::DEFAULT_PREVIEW_CHARS;
+    let mut events = json::RelayStream::new(stream);
+    while let Some(event) = events.next_event(prompt_chars) {
+        match event {
+            Some(event) => handle_event(event),
+            None => debug_log!("Relay: malformed event from {}", peer),
+        }
+    }
+    debug_log!("Relay connection from {} ended", peer);
+}
+
+fn handle_event(event: json::RelayEvent) {
+    if event.session_id.is_empty() {
+        debug_log!("Relay: event without session_id");
+        return;
+    }
+    crate::etw_event!("relay event: {} {}", event.hook_event_name, event.session_id);
+
+    match event.hook_event_name.as_str() {
+        "UserPromptSubmit" => {
+            let st = state::State {
+                user_prompt: event.prompt,
+                saved_at: state::now_stamp(),
+                ..Default::default()
+            };
+            state::save_state(&event.session_id, &st);
+        }
+        "Stop" | "Notification" => {
+            let req = Request {
+                session: event.session_id,
+                input_mode: event.hook_event_name == "Notification",
+                message: event.message,
+                count: 1,
+            };
+            if !host::send_request(&req) {
+                debug_log!("Relay: host window did not take the request");
+            }
+        }
+        "SessionEnd" => state::delete_state(&event.session_id),
+        other => debug_log!("Relay: ignoring event {}", other),
+    }
+}
@@ -1,16 +1,20 @@
 //! Detached child process spawning.
 //!
 //! Uses CreateProcessW with CREATE_NEW_PROCESS_GROUP | DETACHED_PROCESS
-//! to spawn a child that outlives the parent.
+//! to spawn a child that outlives the parent. `spawn_with_payload` also
+//! passes data on the child's stdin instead of the command line.
+//! Children start in the exe directory, so they never keep the hook's
+//! working directory (usually a project folder) in use.
 
 use windows::Win32::System::Threading::*;
 use windows::Win32::UI::WindowsAndMessaging::SW_HIDE;
-use windows::core::PWSTR;
+use windows::core::{PCWSTR, PWSTR};
 
 /// Spawn a detached child process with the given command line.
 /// Returns true on success.
 pub fn spawn_detached(cmd_line: &str) -> bool {
     let mut cmd_wide: Vec<u16> = cmd_line.encode_utf16().chain(std::iter::once(0)).collect();
+    let dir_wide = crate::util::encode_wide(&crate::assets::exe_dir());
 
     let si = STARTUPINFOW {
         cb: std::mem::size_of::<STARTUPINFOW>() as u32,
@@ -30,12 +34,14 @@ pub fn spawn_detached(cmd_line: &str) -> bool {
             false,
             CREATE_NEW_PROCESS_GROUP | DETACHED_PROCESS,
             None,
-            None,
+            PCWSTR(dir_wide.as_ptr()),
             &si,
             &mut pi,
         )
     };
 
+    crate::etw_event!("spawn_detached: ok={} {}", result.is_ok(), cmd_line);
+
     match result {
         Ok(_) => {
             unsafe {
@@ -47,3 +53,111 @@ pub fn spawn_detached(cmd_line: &str) -> bool {
         Err(_) => false,
     }
 }
+
+/// `PROC_THREAD_ATTRIBUTE_HANDLE_LIST`: only the listed handles are inherited.
+const HANDLE_LIST_ATTRIBUTE: usize = 0x0002_0002;
+
+/// Spawn a detached child and hand it `payload` on its stdin.
+///
+/// Only the pipe's read end is inherited (an explicit handle list), so the
+/// child never holds on to the hook's own stdout/stderr pipes. With `boost`
+/// the child starts suspended, gets above-normal priority, and is then
+/// resumed, so it gets the CPU promptly on a loaded machine. A boosted
+/// host lowers itself again once its first toast is shown.
+pub fn spawn_with_payload(cmd_line: &str, payload: &[u8], boost: bool) -> bool {
+    use std::io::Write;
+    use std::os::windows::io::FromRawHandle;
+    use windows::Win32::Foundation::*;
+    use windows::Win32::Security::SECURITY_ATTRIBUTES;
+    use windows::Win32::System::Pipes::CreatePipe;
+
+    let mut cmd_wide: Vec<u16> = cmd_line.encode_utf16().chain(std::iter::once(0)).collect();
+    let dir_wide = crate::util::encode_wide(&crate::assets::exe_dir());
+
+    unsafe {
+        // Inheritable pipe sized to hold the whole payload, so the write
+        // below never waits for the child
+        let sa = SECURITY_ATTRIBUTES {
+            nLength: std::mem::size_of::<SECURITY_ATTRIBUTES>() as u32,
+            lpSecurityDescriptor: std::ptr::null_mut(),
+            bInheritHandle: true.into(),
+        };
+        let mut read = HANDLE::default();
+        let mut write = HANDLE::default();
+        if CreatePipe(&mut read, &mut write, Some(&sa), payload.len().max(4096) as u32).is_err() {
+            return false;
+        }
+        let _ = SetHandleInformation(write, HANDLE_FLAG_INHERIT.0, HANDLE_FLAGS(0));
+
+        let mut attr_size = 0usize;
+        let _ = InitializeProcThreadAttributeList(None, 1, None, &mut attr_size);
+        let mut attr_buf = vec![0u8; attr_size];
+        let attrs = LPPROC_THREAD_ATTRIBUTE_LIST(attr_buf.as_mut_ptr() as *mut _);
+        let inherit = [read];
+        let attrs_ok = InitializeProcThreadAttributeList(Some(attrs), 1, None, &mut attr_size).is_ok()
+            && UpdateProcThreadAttribute(
+                attrs,
+                0,
+                HANDLE_LIST_ATTRIBUTE,
+                Some(inherit.as_ptr() as *const _),
+                std::mem::size_of_val(&inherit),
+                None,
+                None,
+            ).is_ok();
+        if !attrs_ok {
+            let _ = CloseHandle(read);
+            let _ = CloseHandle(write);
+            return false;
+        }
+
+        let si = STARTUPINFOEXW {
+            StartupInfo: STARTUPINFOW {
+                cb: std::mem::size_of::<STARTUPINFOEXW>() as u32,
+                dwFlags: STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES,
+                wShowWindow: SW_HIDE.0 as u16,
+                hStdInput: read,
+                ..Default::default()
+            },
+            lpAttributeList: attrs,
+        };
+
+        let mut flags = CREATE_NEW_PROCESS_GROUP | DETACHED_PROCESS | EXTENDED_STARTUPINFO_PRESENT;
+        if boost {
+            flags |= CREATE_SUSPENDED;
+        }
+
+        let mut pi = PROCESS_INFORMATION::default();
+        let result = CreateProcessW(
+            None,
+            Some(PWSTR(cmd_wide.as_mut_ptr())),
+            None,
+            None,
+            true,
+            flags,
+            None,
+            PCWSTR(dir_wide.as_ptr()),
+            &si.StartupInfo,
+            &mut pi,
+        );
+        DeleteProcThreadAttributeList(attrs);
+        let _ = CloseHandle(read);
+
+        crate::etw_event!("spawn_with_payload: ok={} {}", result.is_ok(), cmd_line);
+        if result.is_err() {
+            let _ = CloseHandle(write);
+            return false;
+        }
+
+        if boost {
+            let _ = SetPriorityClass(pi.hProcess, ABOVE_NORMAL_PRIORITY_CLASS);
+            let _ = SetThreadPriority(pi.hThread, THREAD_PRIORITY_ABOVE_NORMAL);
+            ResumeThread(pi.hThread);
+        }
+        let _ = CloseHandle(pi.hProcess);
+        let _ = CloseHandle(pi.hThread);
+
+        // Closing the write end (File drop) gives the child EOF
+        let mut pipe = std::fs::File::from_raw_handle(write.0);
+        pipe.write_all(payload).is_ok()
+    }
+}
@@ -1,18 +1,90 @@
-//! State file save/load/delete.
+//! Session state store.
 //!
-//! State file: %TEMP%\claude-notify-{session_id}.txt
-//! Format: 4 lines (HWND, RuntimeId, caller exe path, user prompt)
+//! Every session's state lives in one memory-mapped file,
+//! %TEMP%\claude-notify-sessions.dat, shared by all ToastWindow processes
+//! and guarded by a named mutex. The file is a fixed table of SLOT_COUNT
+//! slots addressed by a hash of the session id (linear probing), so
+//! `load_state` is a constant-time lookup and the store never grows:
+//!
+//! ```text
+//! header: magic "CCSS" | version u16 | sweep cursor u16 | slot count u32 | slot size u32
+//! slot:   touched u64 | hash u32 | session len u16 | record len u16 | session id | record
+//! ```
+//!
+//! `touched` is the time of the last write (0 = never used, 1 = deleted).
+//! A slot is marked deleted while it is rewritten, so a write cut short
+//! leaves a tombstone rather than a half-written match. Each save also
+//! checks the next SWEEP_SLOTS slots after the sweep cursor and drops those
+//! untouched for STATE_TTL, so sessions that crashed before SessionEnd
+//! expire on their own. When the table is full the least recently touched
+//! slot is reused.
+//!
+//! A deleted or expired slot that no other entry probes past is marked
+//! never-used again, together with the tombstones just before it, so a miss
+//! keeps stopping early however much the table has churned.
+//!
+//! A record is the session's state:
+//!
+//! ```text
+//! magic "CCNS" | version u16 | reserved u16 | HWND u64 | saved_at u64
+//! [u32 len | bytes] x 4: window class, RuntimeId, caller exe path, user prompt
+//! ```
+//!
+//! `saved_at` (microseconds since the Unix epoch) identifies the prompt a
+//! record belongs to, so a deferred resolver never overwrites a newer save.
+//! All integers are little-endian.
+
+use std::sync::OnceLock;
+use std::time::Duration;
+
+use windows::core::PCWSTR;
+use windows::Win32::Foundation::{CloseHandle, HANDLE, HWND, WAIT_ABANDONED, WAIT_OBJECT_0};
+use windows::Win32::Storage::FileSystem::{
+    CreateFileW, FILE_ATTRIBUTE_NORMAL, FILE_GENERIC_READ, FILE_GENERIC_WRITE, FILE_SHARE_DELETE,
+    FILE_SHARE_READ, FILE_SHARE_WRITE, OPEN_ALWAYS,
+};
+use windows::Win32::System::Memory::{CreateFileMappingW, MapViewOfFile, FILE_MAP_ALL_ACCESS, PAGE_READWRITE};
+use windows::Win32::System::Threading::{CreateMutexW, ReleaseMutex, WaitForSingleObject};
+
+const MAGIC: &[u8; 4] = b"CCNS";
+const VERSION: u16 = 2;
+const HEADER_LEN: usize = 24;
+
+const STORE_MAGIC: &[u8; 4] = b"CCSS";
+const STORE_VERSION: u16 = 1;
+const STORE_HEADER_LEN: usize = 16;
+const SLOT_COUNT: usize = 512;
+const SLOT_SIZE: usize = 2048;
+const SLOT_HEADER_LEN: usize = 16;
+const STORE_LEN: usize = STORE_HEADER_LEN + SLOT_COUNT * SLOT_SIZE;
+const MAX_SESSION_ID_BYTES: usize = 256;
+
+const SLOT_EMPTY: u64 = 0;
+const SLOT_DELETED: u64 = 1;
 
-use windows::Win32::Foundation::HWND;
-use windows::Win32::UI::WindowsAndMessaging::IsWindow;
+/// Slots checked for expiry per save; the whole table every 32 saves.
+const SWEEP_SLOTS: usize = 16;
 
-/// Data stored in and loaded from the state file.
+/// Slots not written for this long are dropped by the sweep.
+const STATE_TTL: Duration = Duration::from_secs(7 * 24 * 60 * 60);
+/// Longest wait for another process holding the store.
+const LOCK_TIMEOUT_MS: u32 = 1000;
+
+const STORE_FILE_NAME: &str = "claude-notify-sessions.dat";
+const STORE_MUTEX_NAME: &str = "Local\\ClaudeCodeNotifyState";
+
+/// Window class of Windows Terminal top-level windows.
+pub const WT_CLASS_NAME: &str = "CASCADIA_HOSTING_WINDOW_CLASS";
+
+/// Data stored in and loaded from the session store.
 pub struct State {
     pub target_hwnd: HWND,
     pub wt_hwnd: HWND,
+    pub window_class: String,
     pub wt_runtime_id: String,
     pub icon_path: String,
     pub user_prompt: String,
+    pub saved_at: u64,
 }
 
 impl Default for State {
@@ -20,81 +92,679 @@ impl Default for State {
         Self {
             target_hwnd: HWND::default(),
             wt_hwnd: HWND::default(),
+            window_class: String::new(),
             wt_runtime_id: String::new(),
             icon_path: String::new(),
             user_prompt: String::new(),
+            saved_at: 0,
         }
     }
 }
 
-/// Get the state file path for a session.
-pub fn state_file_path(session_id: &str) -> std::path::PathBuf {
-    let temp = std::env::temp_dir();
-    temp.join(format!("claude-notify-{}.txt", session_id))
+/// Current time as a `saved_at` stamp.
+pub fn now_stamp() -> u64 {
+    std::time::SystemTime::now()
+        .duration_since(std::time::UNIX_EPOCH)
+        .map(|d| d.as_micros() as u64)
+        .unwrap_or(0)
 }
 
-/// Save state to the state file (4 lines).
-pub fn save_state(session_id: &str, hwnd: HWND, runtime_id: &str, icon_path: &str, prompt: &str) {
-    let path = state_file_path(session_id);
-    let hwnd_val = hwnd.0 as usize;
-    let content = format!("{}\n{}\n{}\n{}", hwnd_val, runtime_id, icon_path, prompt);
-    let _ = std::fs::write(&path, content);
+/// Path of the shared session store.
+pub fn store_path() -> std::path::PathBuf {
+    std::env::temp_dir().join(STORE_FILE_NAME)
 }
 
-/// Load state from the state file.
-pub fn load_state(session_id: &str) -> State {
-    let mut state = State::default();
-    let path = state_file_path(session_id);
+// --- Store mapping ---
 
-    let content = match std::fs::read_to_string(&path) {
-        Ok(c) => c,
-        Err(_) => return state,
-    };
+/// The mapped store. Raw values because the view pointer and HANDLE are
+/// not Send; both stay valid for the life of the process.
+struct Store {
+    view: usize,
+    mutex: isize,
+}
 
-    let lines: Vec<&str> = content.lines().collect();
-
-    // Line 1: HWND
-    if let Some(line) = lines.first() {
-        if let Ok(val) = line.trim().parse::<usize>() {
-            let hwnd = HWND(val as *mut _);
-            if unsafe { IsWindow(Some(hwnd)).as_bool() } {
-                state.target_hwnd = hwnd;
-                // Check if this is Windows Terminal
-                let class = crate::util::get_class_name(hwnd);
-                if class == "CASCADIA_HOSTING_WINDOW_CLASS" {
-                    state.wt_hwnd = hwnd;
-                }
-            }
+static STORE: OnceLock<Option<Store>> = OnceLock::new();
+
+fn open_store() -> Option<Store> {
+    let path = crate::util::encode_wide(&store_path().to_string_lossy());
+    let mutex_name = crate::util::encode_wide(STORE_MUTEX_NAME);
+    unsafe {
+        let mutex = CreateMutexW(None, false, PCWSTR(mutex_name.as_ptr())).ok()?;
+        let file = CreateFileW(
+            PCWSTR(path.as_ptr()),
+            (FILE_GENERIC_READ | FILE_GENERIC_WRITE).0,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            None,
+            OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL,
+            None,
+        ).ok()?;
+        // Grows a new (or older, shorter) file to STORE_LEN, zero-filled
+        let mapping = CreateFileMappingW(file, None, PAGE_READWRITE, 0, STORE_LEN as u32, PCWSTR::null());
+        let _ = CloseHandle(file);
+        let mapping = mapping.ok()?;
+        let view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, STORE_LEN);
+        let _ = CloseHandle(mapping);
+        if view.Value.is_null() {
+            let _ = CloseHandle(mutex);
+            return None;
         }
+        Some(Store { view: view.Value as usize, mutex: mutex.0 as isize })
     }
+}
 
-    // Line 2: RuntimeId
-    if let Some(line) = lines.get(1) {
-        let trimmed = line.trim();
-        if !trimmed.is_empty() {
-            state.wt_runtime_id = trimmed.to_string();
+/// Run `f` on the store bytes while holding the store mutex. Returns None if
+/// the store cannot be opened or another process holds it too long.
+fn with_store<R>(f: impl FnOnce(&mut [u8]) -> R) -> Option<R> {
+    let store = STORE.get_or_init(open_store).as_ref()?;
+    let mutex = HANDLE(store.mutex as *mut _);
+    unsafe {
+        let wait = WaitForSingleObject(mutex, LOCK_TIMEOUT_MS);
+        // An abandoned mutex still grants ownership; records are validated on read
+        if wait != WAIT_OBJECT_0 && wait != WAIT_ABANDONED {
+            crate::debug_log!("State store busy, giving up");
+            return None;
+        }
+        let bytes = std::slice::from_raw_parts_mut(store.view as *mut u8, STORE_LEN);
+        if &bytes[0..4] != STORE_MAGIC
+            || u16::from_le_bytes([bytes[4], bytes[5]]) != STORE_VERSION
+            || read_u32(bytes, 8) as usize != SLOT_COUNT
+            || read_u32(bytes, 12) as usize != SLOT_SIZE
+        {
+            init_store(bytes);
         }
+        let result = f(bytes);
+        let _ = ReleaseMutex(mutex);
+        Some(result)
     }
+}
+
+fn init_store(bytes: &mut [u8]) {
+    bytes.fill(0);
+    bytes[0..4].copy_from_slice(STORE_MAGIC);
+    bytes[4..6].copy_from_slice(&STORE_VERSION.to_le_bytes());
+    bytes[8..12].copy_from_slice(&(SLOT_COUNT as u32).to_le_bytes());
+    bytes[12..16].copy_from_slice(&(SLOT_SIZE as u32).to_le_bytes());
+}
+
+fn read_u32(bytes: &[u8], at: usize) -> u32 {
+    u32::from_le_bytes(bytes[at..at + 4].try_into().unwrap())
+}
+
+fn read_u64(bytes: &[u8], at: usize) -> u64 {
+    u64::from_le_bytes(bytes[at..at + 8].try_into().unwrap())
+}
+
+// --- Slot table ---
+
+/// 32-bit FNV-1a, stable across processes (unlike std's hasher).
+fn session_hash(session_id: &str) -> u32 {
+    let mut hash: u32 = 0x811c_9dc5;
+    for b in session_id.bytes() {
+        hash ^= b as u32;
+        hash = hash.wrapping_mul(0x0100_0193);
+    }
+    hash
+}
 
-    // Line 3: Caller exe path
-    if let Some(line) = lines.get(2) {
-        let trimmed = line.trim();
-        if !trimmed.is_empty() {
-            state.icon_path = trimmed.to_string();
+fn slot(bytes: &mut [u8], index: usize) -> &mut [u8] {
+    let start = STORE_HEADER_LEN + index * SLOT_SIZE;
+    &mut bytes[start..start + SLOT_SIZE]
+}
+
+fn slot_matches(slot: &[u8], hash: u32, session_id: &str) -> bool {
+    let touched = read_u64(slot, 0);
+    if touched == SLOT_EMPTY || touched == SLOT_DELETED || read_u32(slot, 8) != hash {
+        return false;
+    }
+    let len = u16::from_le_bytes([slot[12], slot[13]]) as usize;
+    slot.get(SLOT_HEADER_LEN..SLOT_HEADER_LEN + len) == Some(session_id.as_bytes())
+}
+
+/// Index of the slot holding `session_id`, probing from its home slot
+/// until a never-used slot ends the chain.
+fn find_slot(bytes: &mut [u8], session_id: &str) -> Option<usize> {
+    let hash = session_hash(session_id);
+    let home = hash as usize % SLOT_COUNT;
+    for i in 0..SLOT_COUNT {
+        let index = (home + i) % SLOT_COUNT;
+        let s = slot(bytes, index);
+        if read_u64(s, 0) == SLOT_EMPTY {
+            return None;
+        }
+        if slot_matches(s, hash, session_id) {
+            return Some(index);
         }
     }
+    None
+}
 
-    // Line 4: User prompt (may contain the rest of the file if there were newlines)
-    if lines.len() > 3 {
-        // Join remaining lines back (prompt may contain newlines)
-        state.user_prompt = lines[3..].join("\n");
+/// Slot to write `session_id` into: its current slot, else the first free
+/// one on its probe chain, else the least recently touched slot.
+fn claim_slot(bytes: &mut [u8], session_id: &str) -> usize {
+    if let Some(index) = find_slot(bytes, session_id) {
+        return index;
+    }
+    let home = session_hash(session_id) as usize % SLOT_COUNT;
+    let mut oldest = (home, u64::MAX);
+    for i in 0..SLOT_COUNT {
+        let index = (home + i) % SLOT_COUNT;
+        let touched = read_u64(slot(bytes, index), 0);
+        if touched == SLOT_EMPTY || touched == SLOT_DELETED {
+            return index;
+        }
+        if touched < oldest.1 {
+            oldest = (index, touched);
+        }
     }
+    oldest.0
+}
 
-    state
+/// Drop slots untouched for STATE_TTL among the next SWEEP_SLOTS after the
+/// cursor kept in the store header, and advance the cursor.
+fn sweep_expired(bytes: &mut [u8], now: u64) {
+    let cutoff = now.saturating_sub(STATE_TTL.as_micros() as u64);
+    let cursor = u16::from_le_bytes([bytes[6], bytes[7]]) as usize % SLOT_COUNT;
+    for i in 0..SWEEP_SLOTS {
+        let index = (cursor + i) % SLOT_COUNT;
+        let touched = read_u64(slot(bytes, index), 0);
+        if touched > SLOT_DELETED && touched < cutoff {
+            delete_slot(bytes, index);
+        }
+    }
+    let next = ((cursor + SWEEP_SLOTS) % SLOT_COUNT) as u16;
+    bytes[6..8].copy_from_slice(&next.to_le_bytes());
 }
 
-/// Delete the state file for a session.
+/// Drop the entry in slot `index`. The slot becomes never-used if no live
+/// entry further along the cluster probes past it, and so do the tombstones
+/// right before it; otherwise it stays a tombstone.
+fn delete_slot(bytes: &mut [u8], index: usize) {
+    slot(bytes, index)[0..8].copy_from_slice(&SLOT_DELETED.to_le_bytes());
+    for dist in 1..SLOT_COUNT {
+        let at = (index + dist) % SLOT_COUNT;
+        let s = slot(bytes, at);
+        let touched = read_u64(s, 0);
+        if touched == SLOT_EMPTY {
+            break;
+        }
+        // An entry whose home is at least `dist` slots back was probed past `index`
+        let home = read_u32(s, 8) as usize % SLOT_COUNT;
+        if touched != SLOT_DELETED && (at + SLOT_COUNT - home) % SLOT_COUNT >= dist {
+            return;
+        }
+    }
+    let mut i = index;
+    loop {
+        slot(bytes, i)[0..8].copy_from_slice(&SLOT_EMPTY.to_le_bytes());
+        i = (i + SLOT_COUNT - 1) % SLOT_COUNT;
+        if i == index || read_u64(slot(bytes, i), 0) != SLOT_DELETED {
+            break;
+        }
+    }
+}
+
+fn write_slot(bytes: &mut [u8], index: usize, session_id: &str, record: &[u8], now: u64) {
+    let s = slot(bytes, index);
+    let id_len = session_id.len();
+    // A tombstone until the write completes: still part of the probe chain,
+    // never matched
+    s[0..8].copy_from_slice(&SLOT_DELETED.to_le_bytes());
+    s[8..12].copy_from_slice(&session_hash(session_id).to_le_bytes());
+    s[12..14].copy_from_slice(&(id_len as u16).to_le_bytes());
+    s[14..16].copy_from_slice(&(record.len() as u16).to_le_bytes());
+    s[SLOT_HEADER_LEN..SLOT_HEADER_LEN + id_len].copy_from_slice(session_id.as_bytes());
+    let at = SLOT_HEADER_LEN + id_len;
+    s[at..at + record.len()].copy_from_slice(record);
+    s[0..8].copy_from_slice(&now.max(SLOT_DELETED + 1).to_le_bytes());
+}
+
+fn read_slot(bytes: &mut [u8], index: usize) -> Option<State> {
+    let s = slot(bytes, index);
+    let id_len = u16::from_le_bytes([s[12], s[13]]) as usize;
+    let record_len = u16::from_le_bytes([s[14], s[15]]) as usize;
+    let at = SLOT_HEADER_LEN + id_len;
+    decode_record(s.get(at..at + record_len)?)
+}
+
+// --- Public API ---
+
+/// Save state for a session. `wt_hwnd` is not stored; it is derived from
+/// the window class on load.
+pub fn save_state(session_id: &str, state: &State) {
+    save_state_if(session_id, state, None);
+}
+
+/// Save state for a session, but only if the stored record still has
+/// `saved_at == expected` (checked and written under one lock). With None
+/// the record is written unconditionally. Returns whether it was written.
+pub fn save_state_if(session_id: &str, state: &State, expected: Option<u64>) -> bool {
+    crate::etw_event!("state save: {}", session_id);
+    if session_id.is_empty() || session_id.len() > MAX_SESSION_ID_BYTES {
+        return false;
+    }
+    let record = encode_record(state, SLOT_SIZE - SLOT_HEADER_LEN - session_id.len());
+    with_store(|bytes| store_record(bytes, session_id, &record, expected, now_stamp()))
+        .unwrap_or(false)
+}
+
+/// The locked part of `save_state_if`.
+fn store_record(bytes: &mut [u8], session_id: &str, record: &[u8], expected: Option<u64>, now: u64) -> bool {
+    if let Some(expected) = expected {
+        let current = find_slot(bytes, session_id).and_then(|i| read_slot(bytes, i));
+        if current.map(|st| st.saved_at) != Some(expected) {
+            return false;
+        }
+    }
+    sweep_expired(bytes, now);
+    let index = claim_slot(bytes, session_id);
+    write_slot(bytes, index, session_id, record, now);
+    true
+}
+
+/// Load state for a session. Returns default state if there is no record
+/// or it is unreadable.
+///
+/// The HWND is not probed here; activation checks `IsWindow` when it is used.
+pub fn load_state(session_id: &str) -> State {
+    crate::etw_event!("state load: {}", session_id);
+    with_store(|bytes| find_slot(bytes, session_id).and_then(|i| read_slot(bytes, i)))
+        .flatten()
+        .unwrap_or_default()
+}
+
+/// Delete the state for a session.
 pub fn delete_state(session_id: &str) {
-    let path = state_file_path(session_id);
-    let _ = std::fs::remove_file(&path);
+    let _ = with_store(|bytes| remove_record(bytes, session_id));
+}
+
+fn remove_record(bytes: &mut [u8], session_id: &str) {
+    if let Some(index) = find_slot(bytes, session_id) {
+        delete_slot(bytes, index);
+    }
+}
+
+/// Remove per-session state files (`claude-notify-*.dat` / `.txt`) left in
+/// %TEMP% by versions before the shared store. Scans %TEMP% once, so call
+/// it off the hot path.
+pub fn remove_legacy_files() {
+    let Ok(entries) = std::fs::read_dir(std::env::temp_dir()) else { return };
+    let mut removed = 0usize;
+    for entry in entries.flatten() {
+        let name = entry.file_name();
+        let name = name.to_string_lossy();
+        let legacy = name.starts_with("claude-notify-")
+            && name != STORE_FILE_NAME
+            && (name.ends_with(".dat") || name.ends_with(".txt") || name.ends_with(".tmp"));
+        if legacy && std::fs::remove_file(entry.path()).is_ok() {
+            removed += 1;
+        }
+    }
+    crate::debug_log!("Removed {} legacy state file(s)", removed);
+}
+
+// --- Record encoding ---
+
+/// Encode a record of at most `max_len` bytes. The prompt preview, then
+/// the icon path, are shortened if the fields do not fit.
+fn encode_record(state: &State, max_len: usize) -> Vec<u8> {
+    let mut prompt = state.user_prompt.as_str();
+    let mut icon_path = state.icon_path.as_str();
+    let fixed = HEADER_LEN + 4 * 4 + state.window_class.len() + state.wt_runtime_id.len();
+    let room = max_len.saturating_sub(fixed);
+    if icon_path.len() + prompt.len() > room {
+        prompt = truncate_at_char(prompt, room.saturating_sub(icon_path.len()));
+        if icon_path.len() > room {
+            icon_path = "";
+        }
+    }
+
+    let fields = [
+        truncate_at_char(&state.window_class, max_len / 4),
+        truncate_at_char(&state.wt_runtime_id, max_len / 4),
+        icon_path,
+        prompt,
+    ];
+    let mut record = Vec::with_capacity(
+        HEADER_LEN + fields.iter().map(|f| 4 + f.len()).sum::<usize>(),
+    );
+    record.extend_from_slice(MAGIC);
+    record.extend_from_slice(&VERSION.to_le_bytes());
+    record.extend_from_slice(&0u16.to_le_bytes());
+    record.extend_from_slice(&(state.target_hwnd.0 as usize as u64).to_le_bytes());
+    record.extend_from_slice(&state.saved_at.to_le_bytes());
+    for field in &fields {
+        record.extend_from_slice(&(field.len() as u32).to_le_bytes());
+        record.extend_from_slice(field.as_bytes());
+    }
+    record.truncate(max_len);
+    record
+}
+
+fn truncate_at_char(s: &str, max_bytes: usize) -> &str {
+    if s.len() <= max_bytes {
+        return s;
+    }
+    let mut end = max_bytes;
+    while !s.is_char_boundary(end) {
+        end -= 1;
+    }
+    &s[..end]
+}
+
+fn decode_record(data: &[u8]) -> Option<State> {
+    if data.len() < HEADER_LEN || &data[0..4] != MAGIC {
+        return None;
+    }
+    let version = u16::from_le_bytes(data[4..6].try_into().ok()?);
+    if version != VERSION {
+        return None;
+    }
+    let hwnd_val = u64::from_le_bytes(data[8..16].try_into().ok()?);
+    let saved_at = u64::from_le_bytes(data[16..24].try_into().ok()?);
+
+    let mut pos = HEADER_LEN;
+    let mut next_field = || -> Option<String> {
+        let len = u32::from_le_bytes(data.get(pos..pos + 4)?.try_into().ok()?) as usize;
+        pos += 4;
+        let bytes = data.get(pos..pos + len)?;
+        pos += len;
+        Some(String::from_utf8_lossy(bytes).into_owned())
+    };
+
+    let window_class = next_field()?;
+    let wt_runtime_id = next_field()?;
+    let icon_path = next_field()?;
+    let user_prompt = next_field()?;
+
+    let target_hwnd = HWND(hwnd_val as usize as *mut _);
+    let wt_hwnd = if window_class == WT_CLASS_NAME {
+        target_hwnd
+    } else {
+        HWND::default()
+    };
+
+    Some(State {
+        target_hwnd,
+        wt_hwnd,
+        window_class,
+        wt_runtime_id,
+        icon_path,
+        user_prompt,
+        saved_at,
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const NOW: u64 = 1_700_000_000_000_000;
+
+    fn empty_store() -> Vec<u8> {
+        let mut bytes = vec![0u8; STORE_LEN];
+        init_store(&mut bytes);
+        bytes
+    }
+
+    fn put(bytes: &mut [u8], session_id: &str, prompt: &str, now: u64) -> bool {
+        let st = State { user_prompt: prompt.to_string(), saved_at: now, ..Default::default() };
+        let record = encode_record(&st, SLOT_SIZE - SLOT_HEADER_LEN - session_id.len());
+        store_record(bytes, session_id, &record, None, now)
+    }
+
+    fn get(bytes: &mut [u8], session_id: &str) -> Option<String> {
+        find_slot(bytes, session_id).and_then(|i| read_slot(bytes, i)).map(|st| st.user_prompt)
+    }
+
+    /// Session ids that share one home slot.
+    fn colliding_ids(n: usize) -> Vec<String> {
+        let home = session_hash("s0") as usize % SLOT_COUNT;
+        (0..)
+            .map(|i| format!("s{}", i))
+            .filter(|id| session_hash(id) as usize % SLOT_COUNT == home)
+            .take(n)
+            .collect()
+    }
+
+    /// Slots a lookup of `session_id` reads before it stops at a never-used one.
+    fn probe_len(bytes: &mut [u8], session_id: &str) -> usize {
+        let home = session_hash(session_id) as usize % SLOT_COUNT;
+        let mut len = 1;
+        while len < SLOT_COUNT && read_u64(slot(bytes, (home + len - 1) % SLOT_COUNT), 0) != SLOT_EMPTY {
+            len += 1;
+        }
+        len
+    }
+
+    fn empty_slots(bytes: &mut [u8]) -> usize {
+        (0..SLOT_COUNT).filter(|&i| read_u64(slot(bytes, i), 0) == SLOT_EMPTY).count()
+    }
+
+    #[test]
+    fn record_round_trip() {
+        let st = State {
+            target_hwnd: HWND(0x1234 as *mut _),
+            window_class: WT_CLASS_NAME.to_string(),
+            wt_runtime_id: "42,1,7".to_string(),
+            icon_path: "C:\\Apps\\Code.exe".to_string(),
+            user_prompt: "fix the build".to_string(),
+            saved_at: NOW,
+            ..Default::default()
+        };
+        let decoded = decode_record(&encode_record(&st, 1024)).unwrap();
+        assert_eq!(decoded.target_hwnd, st.target_hwnd);
+        assert_eq!(decoded.wt_hwnd, st.target_hwnd);
+        assert_eq!(decoded.window_class, st.window_class);
+        assert_eq!(decoded.wt_runtime_id, st.wt_runtime_id);
+        assert_eq!(decoded.icon_path, st.icon_path);
+        assert_eq!(decoded.user_prompt, st.user_prompt);
+        assert_eq!(decoded.saved_at, NOW);
+    }
+
+    #[test]
+    fn record_shortens_prompt_at_char_boundary() {
+        let st = State {
+            icon_path: "C:\\Apps\\Code.exe".to_string(),
+            user_prompt: "é".repeat(500),
+            ..Default::default()
+        };
+        let record = encode_record(&st, 101);
+        assert!(record.len() <= 101);
+        let decoded = decode_record(&record).unwrap();
+        assert_eq!(decoded.icon_path, st.icon_path);
+        assert!(!decoded.user_prompt.is_empty());
+        assert!(decoded.user_prompt.chars().all(|c| c == 'é'));
+    }
+
+    #[test]
+    fn decode_rejects_damaged_records() {
+        let record = encode_record(&State { user_prompt: "hello".to_string(), ..Default::default() }, 1024);
+        assert!(decode_record(&record[..record.len() - 1]).is_none());
+        assert!(decode_record(&record[..HEADER_LEN - 1]).is_none());
+
+        let mut bad_magic = record.clone();
+        bad_magic[0] = b'X';
+        assert!(decode_record(&bad_magic).is_none());
+
+        let mut bad_version = record.clone();
+        bad_version[4] = 0xFF;
+        assert!(decode_record(&bad_version).is_none());
+
+        let mut bad_len = record;
+        bad_len[HEADER_LEN..HEADER_LEN + 4].copy_from_slice(&u32::MAX.to_le_bytes());
+        assert!(decode_record(&bad_len).is_none());
+    }
+
+    #[test]
+    fn colliding_sessions_probe_to_neighbouring_slots() {
+        let mut bytes = empty_store();
+        let ids = colliding_ids(3);
+        for (i, id) in ids.iter().enumerate() {
+            assert!(put(&mut bytes, id, &format!("prompt {}", i), NOW));
+        }
+        let home = session_hash(&ids[0]) as usize % SLOT_COUNT;
+        for (i, id) in ids.iter().enumerate() {
+            assert_eq!(find_slot(&mut bytes, id), Some((home + i) % SLOT_COUNT));
+            assert_eq!(get(&mut bytes, id), Some(format!("prompt {}", i)));
+        }
+        assert_eq!(get(&mut bytes, "missing"), None);
+    }
+
+    #[test]
+    fn rewrite_stays_in_its_slot() {
+        let mut bytes = empty_store();
+        assert!(put(&mut bytes, "a", "first", NOW));
+        let index = find_slot(&mut bytes, "a");
+        assert!(put(&mut bytes, "a", "second", NOW + 1));
+        assert_eq!(find_slot(&mut bytes, "a"), index);
+        assert_eq!(get(&mut bytes, "a").as_deref(), Some("second"));
+    }
+
+    #[test]
+    fn tombstone_keeps_probe_chain_and_is_reused() {
+        let mut bytes = empty_store();
+        let ids = colliding_ids(4);
+        for id in &ids[..3] {
+            put(&mut bytes, id, id, NOW);
+        }
+        let deleted_index = find_slot(&mut bytes, &ids[1]).unwrap();
+        remove_record(&mut bytes, &ids[1]);
+
+        assert_eq!(get(&mut bytes, &ids[1]), None);
+        assert_eq!(get(&mut bytes, &ids[2]).as_deref(), Some(ids[2].as_str()));
+
+        put(&mut bytes, &ids[3], &ids[3], NOW);
+        assert_eq!(find_slot(&mut bytes, &ids[3]), Some(deleted_index));
+    }
+
+    #[test]
+    fn deleting_a_chain_tail_reclaims_its_tombstones() {
+        let mut bytes = empty_store();
+        let ids = colliding_ids(3);
+        for id in &ids {
+            put(&mut bytes, id, id, NOW);
+        }
+        remove_record(&mut bytes, &ids[1]);
+        assert_eq!(empty_slots(&mut bytes), SLOT_COUNT - 3);
+
+        remove_record(&mut bytes, &ids[2]);
+        assert_eq!(empty_slots(&mut bytes), SLOT_COUNT - 1);
+        assert_eq!(get(&mut bytes, &ids[0]).as_deref(), Some(ids[0].as_str()));
+    }
+
+    #[test]
+    fn misses_stay_short_after_the_table_has_churned() {
+        let mut bytes = empty_store();
+        let ids: Vec<String> = (0..SLOT_COUNT).map(|i| format!("s{}", i)).collect();
+        for (i, id) in ids.iter().enumerate() {
+            put(&mut bytes, id, "x", NOW + i as u64);
+        }
+        assert_eq!(empty_slots(&mut bytes), 0);
+        assert_eq!(probe_len(&mut bytes, "nobody"), SLOT_COUNT);
+
+        // Any order: every slot must end up never-used again
+        for i in 0..SLOT_COUNT {
+            remove_record(&mut bytes, &ids[i * 7 % SLOT_COUNT]);
+        }
+        assert_eq!(empty_slots(&mut bytes), SLOT_COUNT);
+        assert_eq!(probe_len(&mut bytes, "nobody"), 1);
+
+        for (i, id) in ids.iter().enumerate() {
+            put(&mut bytes, id, "x", NOW + i as u64);
+        }
+        for id in &ids {
+            remove_record(&mut bytes, id);
+        }
+        assert_eq!(empty_slots(&mut bytes), SLOT_COUNT);
+    }
+
+    #[test]
+    fn churn_never_loses_a_live_session() {
+        let mut bytes = empty_store();
+        let mut live = std::collections::HashSet::new();
+        let mut seed: u32 = 12345;
+        for step in 0..20_000u64 {
+            seed = seed.wrapping_mul(1_103_515_245).wrapping_add(12_345);
+            let id = format!("s{}", (seed >> 8) % 400);
+            if (seed >> 4) % 3 == 0 {
+                remove_record(&mut bytes, &id);
+                live.remove(&id);
+            } else {
+                put(&mut bytes, &id, &id, NOW + step);
+                live.insert(id);
+            }
+        }
+        for id in &live {
+            assert_eq!(get(&mut bytes, id).as_deref(), Some(id.as_str()));
+        }
+        assert!(SLOT_COUNT - empty_slots(&mut bytes) >= live.len());
+    }
+
+    #[test]
+    fn slot_being_rewritten_is_never_matched() {
+        let mut bytes = empty_store();
+        let ids = colliding_ids(2);
+        put(&mut bytes, &ids[0], "old", NOW);
+        put(&mut bytes, &ids[1], "next", NOW);
+
+        // State of a rewrite cut short after its first step
+        let index = find_slot(&mut bytes, &ids[0]).unwrap();
+        let s = slot(&mut bytes, index);
+        s[0..8].copy_from_slice(&SLOT_DELETED.to_le_bytes());
+        s[SLOT_HEADER_LEN + ids[0].len()] = 0;
+
+        assert_eq!(get(&mut bytes, &ids[0]), None);
+        assert_eq!(get(&mut bytes, &ids[1]).as_deref(), Some("next"));
+    }
+
+    #[test]
+    fn conditional_save_checks_stamp() {
+        let mut bytes = empty_store();
+        put(&mut bytes, "a", "first", NOW);
+        let st = State { user_prompt: "resolved".to_string(), saved_at: NOW, ..Default::default() };
+        let record = encode_record(&st, 1024);
+
+        assert!(!store_record(&mut bytes, "a", &record, Some(NOW - 1), NOW + 1));
+        assert_eq!(get(&mut bytes, "a").as_deref(), Some("first"));
+        assert!(store_record(&mut bytes, "a", &record, Some(NOW), NOW + 1));
+        assert_eq!(get(&mut bytes, "a").as_deref(), Some("resolved"));
+        assert!(!store_record(&mut bytes, "b", &record, Some(NOW), NOW + 1));
+    }
+
+    #[test]
+    fn sweep_covers_the_table_a_few_slots_at_a_time() {
+        let mut bytes = empty_store();
+        let expired = NOW - STATE_TTL.as_micros() as u64 - 1;
+        let ids: Vec<String> = (0..40).map(|i| format!("old{}", i)).collect();
+        for id in &ids {
+            put(&mut bytes, id, "stale", expired);
+        }
+        // The puts above swept too; start the pass from a known cursor
+        bytes[6..8].copy_from_slice(&0u16.to_le_bytes());
+        put(&mut bytes, "fresh", "live", NOW);
+        assert_eq!(u16::from_le_bytes([bytes[6], bytes[7]]) as usize, SWEEP_SLOTS);
+
+        for _ in 1..SLOT_COUNT / SWEEP_SLOTS {
+            sweep_expired(&mut bytes, NOW);
+        }
+        assert_eq!(u16::from_le_bytes([bytes[6], bytes[7]]), 0);
+        for id in &ids {
+            assert_eq!(get(&mut bytes, id), None);
+        }
+        assert_eq!(get(&mut bytes, "fresh").as_deref(), Some("live"));
+        assert_eq!(empty_slots(&mut bytes), SLOT_COUNT - 1);
+    }
+
+    #[test]
+    fn full_table_reuses_least_recently_touched_slot() {
+        let mut bytes = empty_store();
+        for i in 0..SLOT_COUNT {
+            assert!(put(&mut bytes, &format!("s{}", i), "x", NOW + i as u64));
+        }
+        put(&mut bytes, "newcomer", "y", NOW + SLOT_COUNT as u64);
+        assert_eq!(get(&mut bytes, "s0"), None);
+        assert_eq!(get(&mut bytes, "newcomer").as_deref(), Some("y"));
+        assert_eq!(get(&mut bytes, "s1").as_deref(), Some("x"));
+    }
 }
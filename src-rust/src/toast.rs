@@ -1,20 +1,36 @@
 //! Toast window: rendering, WndProc, timers, mouse interaction, stacking.
 //!
-//! Implements the full toast notification window with GDI drawing,
-//! fade-out animation, Telegram-style stacking, and click-to-activate.
+//! Implements the full toast notification window with GDI drawing into a
+//! cached back buffer, per-pixel-alpha layered presentation, fade-out
+//! animation, Telegram-style stacking, and click-to-activate.
+//!
+//! Geometry and font heights are defined at 96 DPI and scaled to the
+//! toast's monitor once per DPI (`layout_for_dpi`). The process is
+//! per-monitor-v2 DPI aware, so a toast re-renders itself on WM_DPICHANGED
+//! instead of being bitmap-stretched by the system.
+//!
+//! A thread may `prepare_toast` ahead of time: the window is created hidden
+//! and its back buffer allocated with the style's chrome already drawn, so
+//! the next `show_toast` on that thread only draws text and icon and shows.
 
 use std::cell::RefCell;
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
 
 use windows::core::*;
 use windows::Win32::Foundation::*;
 use windows::Win32::Graphics::Gdi::*;
 use windows::Win32::System::LibraryLoader::GetModuleHandleW;
 use windows::Win32::UI::Input::KeyboardAndMouse::{TrackMouseEvent, TRACKMOUSEEVENT, TME_LEAVE};
+use windows::Win32::UI::HiDpi::{GetDpiForMonitor, MDT_EFFECTIVE_DPI};
 use windows::Win32::UI::Shell::*;
 use windows::Win32::UI::WindowsAndMessaging::*;
 
 // --- Constants (SPEC Sections 8.2, 8.3, 10.1, 10.2) ---
 
+// Geometry at 96 DPI; see `Layout` for the scaled values
+const BASE_DPI: u32 = 96;
 const WINDOW_WIDTH: i32 = 300;
 const WINDOW_HEIGHT: i32 = 80;
 const ICON_SIZE: i32 = 48;
@@ -22,6 +38,13 @@ const ICON_PADDING: i32 = 16;
 const CLOSE_BUTTON_SIZE: i32 = 20;
 const CLOSE_BUTTON_MARGIN: i32 = 6;
 const BORDER_WIDTH: i32 = 2;
+const TITLE_FONT_HEIGHT: i32 = 18;
+const MESSAGE_FONT_HEIGHT: i32 = 14;
+const CLOSE_FONT_HEIGHT: i32 = 16;
+const TITLE_TOP: i32 = 15;
+const TITLE_BOTTOM: i32 = 40;
+const MESSAGE_TOP: i32 = 42;
+const TEXT_MARGIN: i32 = 10;
 
 const COLOR_BG: u32 = 0x00333333;
 const COLOR_BORDER_NORMAL: u32 = 0x004B64B2;
@@ -30,22 +53,27 @@ const COLOR_TITLE: u32 = 0x00FFFFFF;
 const COLOR_MESSAGE: u32 = 0x00CCCCCC;
 const COLOR_CLOSE: u32 = 0x00888888;
 
-const TIMER_FADE: usize = 1;
-const TIMER_START_FADE: usize = 2;
-const TIMER_REPOSITION: usize = 3;
-const TIMER_CHECK_BOTTOM: usize = 4;
+const TIMER_START_FADE: usize = 1;
 
 const DISPLAY_MS: u32 = 3000;
-const FADE_MS: u32 = 1000;
+const FADE: Duration = Duration::from_millis(1000);
+const SLIDE: Duration = Duration::from_millis(200);
 const INITIAL_ALPHA: u8 = 230;
 
 const TOAST_CLASS_NAME: &str = "ClaudeCodeToast";
 
+/// Upper bound on simultaneously visible toasts, whatever the work area.
+const MAX_VISIBLE_TOASTS: usize = 8;
+
+/// Posted to the remaining toasts when one closes; each recomputes its
+/// rank from the registry and slides to that slot.
 const WM_TOAST_CHECK_POSITION: u32 = WM_USER + 101;
 const WM_TOAST_PAUSE_TIMER: u32 = WM_USER + 102;
+/// Content for a live toast is waiting in UPDATES.
+const WM_TOAST_UPDATE: u32 = WM_USER + 104;
 const WM_MOUSELEAVE: u32 = 0x02A3;
 
-// --- Global state for the toast window (per-process, one toast per process) ---
+// --- State for the toast window (per-thread, one toast per UI thread) ---
 
 struct ToastState {
     hwnd: HWND,
@@ -53,28 +81,122 @@ struct ToastState {
     message: String,
     input_mode: bool,
     font_family: String,
-    icon: HICON,
+    icon: Option<Arc<crate::assets::IconBitmap>>,
+    icon_path: String,
     default_icon_path: String,
+    // Geometry for the DPI of the toast's monitor
+    layout: Layout,
     // Activation targets
     target_hwnd: HWND,
     wt_hwnd: HWND,
     wt_runtime_id: String,
-    // Fade state
+    // Fade state (fade_start is set while fading out)
     alpha: u8,
-    fade_step: u8,
-    is_fading: bool,
+    fade_start: Option<Instant>,
     // Mouse state
     mouse_inside: bool,
     // Stacking state
-    target_y: i32,
+    work_area: RECT,
+    slide: Option<Slide>,
     is_bottom_toast: bool,
     taskbar_edge: u32,
     // Clicked flag
     clicked: bool,
+    // Rendered content, built once and reused for every frame
+    back_buffer: Option<BackBuffer>,
+}
+
+/// Toast geometry in physical pixels for one DPI.
+#[derive(Clone, Copy)]
+struct Layout {
+    dpi: u32,
+    width: i32,
+    height: i32,
+    icon_size: i32,
+    icon_padding: i32,
+    close_size: i32,
+    close_margin: i32,
+    border: i32,
+    title_font: i32,
+    message_font: i32,
+    close_font: i32,
+    title_top: i32,
+    title_bottom: i32,
+    message_top: i32,
+    text_margin: i32,
+}
+
+/// Layouts computed so far; a session rarely sees more than two DPIs.
+static LAYOUTS: Mutex<Vec<Layout>> = Mutex::new(Vec::new());
+
+fn scale(value: i32, dpi: u32) -> i32 {
+    (value * dpi as i32 + BASE_DPI as i32 / 2) / BASE_DPI as i32
+}
+
+fn layout_for_dpi(dpi: u32) -> Layout {
+    let mut layouts = LAYOUTS.lock().unwrap_or_else(|e| e.into_inner());
+    if let Some(layout) = layouts.iter().find(|l| l.dpi == dpi) {
+        return *layout;
+    }
+    let layout = Layout {
+        dpi,
+        width: scale(WINDOW_WIDTH, dpi),
+        height: scale(WINDOW_HEIGHT, dpi),
+        icon_size: scale(ICON_SIZE, dpi),
+        icon_padding: scale(ICON_PADDING, dpi),
+        close_size: scale(CLOSE_BUTTON_SIZE, dpi),
+        close_margin: scale(CLOSE_BUTTON_MARGIN, dpi),
+        border: scale(BORDER_WIDTH, dpi).max(1),
+        title_font: scale(TITLE_FONT_HEIGHT, dpi),
+        message_font: scale(MESSAGE_FONT_HEIGHT, dpi),
+        close_font: scale(CLOSE_FONT_HEIGHT, dpi),
+        title_top: scale(TITLE_TOP, dpi),
+        title_bottom: scale(TITLE_BOTTOM, dpi),
+        message_top: scale(MESSAGE_TOP, dpi),
+        text_margin: scale(TEXT_MARGIN, dpi),
+    };
+    layouts.push(layout);
+    layout
+}
+
+/// Content handed to a live toast by `update_toast`.
+struct ToastUpdate {
+    title: String,
+    message: String,
+    /// Run on the toast's thread once the content is on screen
+    applied: Box<dyn FnOnce() + Send>,
+}
+
+/// Updates waiting for their toast, by raw window handle. Kept here rather
+/// than in the posted message so an update never leaks when its window goes
+/// away first; a newer update for the same toast replaces an older one.
+static UPDATES: Mutex<Vec<(isize, ToastUpdate)>> = Mutex::new(Vec::new());
+
+fn take_update(hwnd: HWND) -> Option<ToastUpdate> {
+    let mut updates = UPDATES.lock().unwrap_or_else(|e| e.into_inner());
+    let index = updates.iter().position(|(h, _)| *h == hwnd.0 as isize)?;
+    Some(updates.remove(index).1)
+}
+
+/// A move to a new stack slot, driven by the animation clock.
+#[derive(Clone, Copy)]
+struct Slide {
+    from_y: i32,
+    to_y: i32,
+    start: Instant,
+}
+
+/// A hidden toast window made by `prepare_toast`, waiting for content.
+struct Prepared {
+    hwnd: HWND,
+    layout: Layout,
+    input_mode: bool,
+    buffer: BackBuffer,
 }
 
 thread_local! {
     static TOAST: RefCell<Option<ToastState>> = const { RefCell::new(None) };
+    static PREPARED: RefCell<Option<Prepared>> = const { RefCell::new(None) };
 }
 
 /// Execute a closure with an immutable reference to the toast state.
@@ -110,184 +232,269 @@ fn make_font(height: i32, bold: bool, family: &str) -> HFONT {
     }
 }
 
-fn is_point_in_close_button(x: i32, y: i32) -> bool {
-    let btn_left = WINDOW_WIDTH - CLOSE_BUTTON_MARGIN - CLOSE_BUTTON_SIZE;
-    let btn_top = CLOSE_BUTTON_MARGIN;
-    x >= btn_left && x <= btn_left + CLOSE_BUTTON_SIZE
-        && y >= btn_top && y <= btn_top + CLOSE_BUTTON_SIZE
+// --- GDI resource cache ---
+
+/// Fonts and brushes shared by every toast in the process, created on
+/// first use and freed by `release_gdi_cache`. GDI objects are not bound
+/// to a thread, so host toast threads share them. Handles are stored as
+/// raw values because HFONT/HBRUSH are not Send.
+struct GdiCache {
+    fonts: HashMap<(String, i32, bool), isize>,
+    brushes: HashMap<u32, isize>,
 }
 
-// --- Stacking helpers ---
+static GDI_CACHE: Mutex<Option<GdiCache>> = Mutex::new(None);
 
-struct ToastInfo {
-    hwnd: HWND,
-    rect: RECT,
+fn with_gdi_cache<R>(f: impl FnOnce(&mut GdiCache) -> R) -> R {
+    let mut guard = GDI_CACHE.lock().unwrap_or_else(|e| e.into_inner());
+    let cache = guard.get_or_insert_with(|| GdiCache {
+        fonts: HashMap::new(),
+        brushes: HashMap::new(),
+    });
+    f(cache)
 }
 
-fn enum_other_toasts() -> Vec<ToastInfo> {
-    let mut toasts: Vec<ToastInfo> = Vec::new();
+fn cached_font(height: i32, bold: bool, family: &str) -> HFONT {
+    with_gdi_cache(|cache| {
+        let key = (family.to_string(), height, bold);
+        let raw = *cache.fonts.entry(key).or_insert_with(|| make_font(height, bold, family).0 as isize);
+        HFONT(raw as *mut _)
+    })
+}
 
-    unsafe extern "system" fn callback(hwnd: HWND, lparam: LPARAM) -> BOOL {
-        let toasts = &mut *(lparam.0 as *mut Vec<ToastInfo>);
-        let my_hwnd = TOAST.with(|cell| {
-            cell.borrow().as_ref().map(|t| t.hwnd).unwrap_or_default()
+fn cached_brush(color: u32) -> HBRUSH {
+    with_gdi_cache(|cache| {
+        let raw = *cache.brushes.entry(color).or_insert_with(|| unsafe {
+            CreateSolidBrush(COLORREF(color)).0 as isize
         });
-        if hwnd == my_hwnd {
-            return TRUE;
-        }
-        let mut class_buf = [0u16; 256];
-        let len = GetClassNameW(hwnd, &mut class_buf);
-        let class = String::from_utf16_lossy(&class_buf[..len as usize]);
-        if class == TOAST_CLASS_NAME && IsWindowVisible(hwnd).as_bool() {
-            let mut rect = RECT::default();
-            let _ = GetWindowRect(hwnd, &mut rect);
-            toasts.push(ToastInfo { hwnd, rect });
+        HBRUSH(raw as *mut _)
+    })
+}
+
+/// Free all cached fonts and brushes. Call when the process stops showing toasts.
+pub fn release_gdi_cache() {
+    let mut guard = GDI_CACHE.lock().unwrap_or_else(|e| e.into_inner());
+    if let Some(cache) = guard.take() {
+        for raw in cache.fonts.into_values().chain(cache.brushes.into_values()) {
+            unsafe { let _ = DeleteObject(HGDIOBJ(raw as *mut _)); }
         }
-        TRUE
     }
+}
 
-    unsafe {
-        let _ = EnumWindows(
-            Some(callback),
-            LPARAM(&mut toasts as *mut Vec<ToastInfo> as isize),
-        );
-    }
+fn is_point_in_close_button(layout: &Layout, x: i32, y: i32) -> bool {
+    let btn_left = layout.width - layout.close_margin - layout.close_size;
+    let btn_top = layout.close_margin;
+    x >= btn_left && x <= btn_left + layout.close_size
+        && y >= btn_top && y <= btn_top + layout.close_size
+}
+
+// --- Monitor metrics cache ---
 
-    toasts
+/// Work area and DPI of one monitor.
+#[derive(Clone, Copy)]
+struct MonitorMetrics {
+    work_area: RECT,
+    dpi: u32,
 }
 
-fn calculate_position(work_area: &RECT, taskbar_edge: u32) -> (i32, i32) {
-    let other_toasts = enum_other_toasts();
+/// Monitor metrics and the taskbar edge, queried on first use and kept
+/// until a display or settings change (`invalidate_monitor_cache`).
+/// Monitors are keyed by raw HMONITOR because HMONITOR is not Send.
+struct MonitorCache {
+    monitors: HashMap<isize, MonitorMetrics>,
+    taskbar_edge: Option<u32>,
+}
+
+static MONITOR_CACHE: Mutex<Option<MonitorCache>> = Mutex::new(None);
+
+fn with_monitor_cache<R>(f: impl FnOnce(&mut MonitorCache) -> R) -> R {
+    let mut guard = MONITOR_CACHE.lock().unwrap_or_else(|e| e.into_inner());
+    let cache = guard.get_or_insert_with(|| MonitorCache {
+        monitors: HashMap::new(),
+        taskbar_edge: None,
+    });
+    f(cache)
+}
+
+/// Forget cached monitor metrics. Call on WM_DISPLAYCHANGE,
+/// WM_SETTINGCHANGE and WM_DPICHANGED.
+pub fn invalidate_monitor_cache() {
+    *MONITOR_CACHE.lock().unwrap_or_else(|e| e.into_inner()) = None;
+}
+
+fn monitor_metrics(monitor: HMONITOR) -> MonitorMetrics {
+    with_monitor_cache(|cache| {
+        *cache.monitors.entry(monitor.0 as isize).or_insert_with(|| unsafe {
+            let mut mi = MONITORINFO {
+                cbSize: std::mem::size_of::<MONITORINFO>() as u32,
+                ..Default::default()
+            };
+            let _ = GetMonitorInfoW(monitor, &mut mi);
+
+            let (mut dpi_x, mut dpi_y) = (0u32, 0u32);
+            let dpi = if GetDpiForMonitor(monitor, MDT_EFFECTIVE_DPI, &mut dpi_x, &mut dpi_y).is_ok()
+                && dpi_x != 0
+            {
+                dpi_x
+            } else {
+                BASE_DPI
+            };
+            MonitorMetrics { work_area: mi.rcWork, dpi }
+        })
+    })
+}
+
+fn cursor_monitor_metrics() -> MonitorMetrics {
+    let monitor = unsafe {
+        let mut cursor_pos = POINT::default();
+        let _ = GetCursorPos(&mut cursor_pos);
+        MonitorFromPoint(cursor_pos, MONITOR_DEFAULTTOPRIMARY)
+    };
+    monitor_metrics(monitor)
+}
+
+/// Edge length of the caller icon for a toast shown now, in pixels.
+pub fn icon_size() -> i32 {
+    layout_for_dpi(cursor_monitor_metrics().dpi).icon_size
+}
+
+// --- Stacking helpers ---
 
+/// Visible toasts other than this one, from the process toast registry.
+fn enum_other_toasts() -> Vec<HWND> {
+    let my_hwnd = TOAST.with(|cell| {
+        cell.borrow().as_ref().map(|t| t.hwnd).unwrap_or_default()
+    });
+
+    crate::registry::others(my_hwnd)
+        .into_iter()
+        .filter(|&hwnd| unsafe { IsWindowVisible(hwnd).as_bool() })
+        .collect()
+}
+
+/// Top edge of the stack slot at `rank` (0 = next to the taskbar).
+fn slot_y(work_area: &RECT, taskbar_edge: u32, height: i32, rank: usize) -> i32 {
+    if taskbar_edge == ABE_TOP as u32 {
+        // Stack downwards from the top
+        work_area.top + rank as i32 * height
+    } else {
+        // Stack upwards from the bottom
+        work_area.bottom - (rank as i32 + 1) * height
+    }
+}
+
+/// How many toasts fit on the cursor monitor's work area, capped at
+/// MAX_VISIBLE_TOASTS. The host keeps further toasts queued.
+pub fn stack_capacity() -> usize {
+    let metrics = cursor_monitor_metrics();
+    let height = layout_for_dpi(metrics.dpi).height;
+    let fit = (metrics.work_area.bottom - metrics.work_area.top) / height;
+    (fit.max(1) as usize).min(MAX_VISIBLE_TOASTS)
+}
+
+fn calculate_position(work_area: &RECT, taskbar_edge: u32, layout: &Layout) -> (i32, i32) {
     // X position
     let x = if taskbar_edge == ABE_LEFT as u32 {
         work_area.left
     } else {
-        work_area.right - WINDOW_WIDTH
+        work_area.right - layout.width
     };
 
-    // Y position
-    let y = if other_toasts.is_empty() {
-        // First toast
-        if taskbar_edge == ABE_TOP as u32 {
-            work_area.top
-        } else {
-            work_area.bottom - WINDOW_HEIGHT
-        }
-    } else {
-        if taskbar_edge == ABE_TOP as u32 {
-            // Stack below: find lowest bottom
-            let lowest_bottom = other_toasts.iter().map(|t| t.rect.bottom).max().unwrap_or(work_area.top);
-            lowest_bottom
-        } else {
-            // Stack above: find highest top
-            let highest_top = other_toasts.iter().map(|t| t.rect.top).min().unwrap_or(work_area.bottom);
-            highest_top - WINDOW_HEIGHT
-        }
-    };
+    // Y position: the slot above (or below) every existing toast
+    let y = slot_y(work_area, taskbar_edge, layout.height, enum_other_toasts().len());
 
     (x, y)
 }
 
-fn is_bottom_toast_check(hwnd: HWND, _taskbar_edge: u32) -> bool {
-    let other_toasts = enum_other_toasts();
-    if other_toasts.is_empty() {
-        return true;
-    }
-
-    // Bottom toast = the one with the lowest HWND value (created earliest, closest to taskbar)
-    for t in &other_toasts {
-        if (t.hwnd.0 as usize) < (hwnd.0 as usize) {
-            return false;
-        }
-    }
-    true
+fn is_bottom_toast_check(hwnd: HWND) -> bool {
+    // Bottom toast = the oldest live toast (created earliest, closest to taskbar)
+    crate::registry::is_oldest(hwnd)
 }
 
+/// Ask the remaining toasts to reflow after this one leaves the stack.
+/// Posted, not sent: a slow toast never stalls the closing one, and each
+/// receiver folds queued requests into a single reflow pass.
 fn notify_other_toasts_closing(my_hwnd: HWND) {
-    let mut my_rect = RECT::default();
-    unsafe { let _ = GetWindowRect(my_hwnd, &mut my_rect); }
+    crate::registry::unregister(my_hwnd);
 
-    let others = enum_other_toasts();
-    for t in &others {
+    for hwnd in crate::registry::others(my_hwnd) {
         unsafe {
-            let _ = SendMessageW(
-                t.hwnd,
-                WM_TOAST_CHECK_POSITION,
-                Some(WPARAM(my_rect.top as usize)),
-                Some(LPARAM(0)),
-            );
+            let _ = PostMessageW(Some(hwnd), WM_TOAST_CHECK_POSITION, WPARAM(0), LPARAM(0));
         }
     }
 }
 
 fn notify_all_toasts_pause_timer(pause: bool) {
     let my_hwnd = with_toast(|t| t.hwnd);
-    // Send to self
+    let flag = WPARAM(if pause { 1 } else { 0 });
+    // Send to self (same thread, handled synchronously)
     unsafe {
-        let _ = SendMessageW(
-            my_hwnd,
-            WM_TOAST_PAUSE_TIMER,
-            Some(WPARAM(if pause { 1 } else { 0 })),
-            Some(LPARAM(0)),
-        );
+        let _ = SendMessageW(my_hwnd, WM_TOAST_PAUSE_TIMER, Some(flag), Some(LPARAM(0)));
     }
-    // Send to others
-    let others = enum_other_toasts();
-    for t in &others {
+    // Post to others so a busy toast cannot stall hover handling
+    for hwnd in enum_other_toasts() {
         unsafe {
-            let _ = SendMessageW(
-                t.hwnd,
-                WM_TOAST_PAUSE_TIMER,
-                Some(WPARAM(if pause { 1 } else { 0 })),
-                Some(LPARAM(0)),
-            );
+            let _ = PostMessageW(Some(hwnd), WM_TOAST_PAUSE_TIMER, flag, LPARAM(0));
         }
     }
 }
 
-fn animate_to_position(hwnd: HWND) {
+/// Advance this toast's fade and slide to the current time. Called once per
+/// clock frame; stops the clock for this window when nothing is moving.
+fn animation_frame(hwnd: HWND) {
+    let now = Instant::now();
     let mut rect = RECT::default();
     unsafe { let _ = GetWindowRect(hwnd, &mut rect); }
 
-    let (target_y, done) = with_toast_mut(|state| {
-        let current_y = rect.top;
-        let diff = state.target_y - current_y;
-
-        if diff == 0 {
-            return (0, true);
-        }
-
-        let mut step = diff * 2 / 5;
-        if step == 0 {
-            step = if diff > 0 { 2 } else { -2 };
+    let (fade_done, faded, new_y, active) = with_toast_mut(|state| {
+        let mut fade_done = false;
+        let mut faded = false;
+        if let Some(start) = state.fade_start {
+            let t = now.duration_since(start).as_secs_f32() / FADE.as_secs_f32();
+            if t >= 1.0 {
+                fade_done = true;
+            } else {
+                state.alpha = (INITIAL_ALPHA as f32 * (1.0 - t)) as u8;
+                faded = true;
+            }
         }
 
-        let mut new_y = current_y + step;
-        if (state.target_y - new_y).abs() < 4 {
-            new_y = state.target_y;
+        let mut new_y = None;
+        if let Some(slide) = state.slide {
+            let t = (now.duration_since(slide.start).as_secs_f32() / SLIDE.as_secs_f32()).min(1.0);
+            // Ease-out cubic: fast start, gentle landing
+            let eased = 1.0 - (1.0 - t).powi(3);
+            new_y = Some(slide.from_y + ((slide.to_y - slide.from_y) as f32 * eased).round() as i32);
+            if t >= 1.0 {
+                state.slide = None;
+            }
         }
 
-        (new_y, new_y == state.target_y)
+        (fade_done, faded, new_y, state.fade_start.is_some() || state.slide.is_some())
     });
-
-    if done && target_y == 0 {
-        // diff was 0, just kill timer
-        unsafe { let _ = KillTimer(Some(hwnd), TIMER_REPOSITION); }
-        return;
+    if faded {
+        present_toast();
     }
 
-    unsafe {
-        let _ = SetWindowPos(
-            hwnd,
-            None,
-            rect.left, target_y, 0, 0,
-            SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE,
-        );
+    if let Some(y) = new_y {
+        if y != rect.top {
+            unsafe {
+                let _ = SetWindowPos(
+                    hwnd,
+                    None,
+                    rect.left, y, 0, 0,
+                    SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE,
+                );
+            }
+        }
     }
 
-    if done {
-        unsafe { let _ = KillTimer(Some(hwnd), TIMER_REPOSITION); }
+    if fade_done {
+        crate::animation::stop(hwnd);
+        notify_other_toasts_closing(hwnd);
+        unsafe { let _ = DestroyWindow(hwnd); }
+    } else if !active {
+        crate::animation::stop(hwnd);
     }
 }
 
@@ -299,48 +506,25 @@ unsafe extern "system" fn wnd_proc(
     wparam: WPARAM,
     lparam: LPARAM,
 ) -> LRESULT {
-    match msg {
-        WM_PAINT => {
-            paint(hwnd);
-            LRESULT(0)
-        }
+    // Ahead of the guard below, so an update is retried rather than dropped
+    if msg == WM_TOAST_UPDATE {
+        apply_update(hwnd);
+        return LRESULT(0);
+    }
 
+    // A prepared window has no toast state until it is shown, and a message
+    // sent while the state is borrowed must not borrow it again
+    if TOAST.with(|cell| cell.try_borrow_mut().map_or(true, |s| s.is_none())) {
+        return DefWindowProcW(hwnd, msg, wparam, lparam);
+    }
+
+    match msg {
         WM_TIMER => {
             match wparam.0 {
                 TIMER_START_FADE => {
                     let _ = KillTimer(Some(hwnd), TIMER_START_FADE);
-                    with_toast_mut(|state| state.is_fading = true);
-                    SetTimer(Some(hwnd), TIMER_FADE, 16, None);
-                }
-                TIMER_FADE => {
-                    let should_destroy = with_toast_mut(|state| {
-                        if state.alpha > state.fade_step {
-                            state.alpha -= state.fade_step;
-                            let _ = SetLayeredWindowAttributes(hwnd, COLORREF(0), state.alpha, LWA_ALPHA);
-                            false
-                        } else {
-                            state.is_fading = false;
-                            true
-                        }
-                    });
-                    if should_destroy {
-                        let _ = KillTimer(Some(hwnd), TIMER_FADE);
-                        notify_other_toasts_closing(hwnd);
-                        let _ = DestroyWindow(hwnd);
-                    }
-                }
-                TIMER_REPOSITION => {
-                    animate_to_position(hwnd);
-                }
-                TIMER_CHECK_BOTTOM => {
-                    let taskbar_edge = with_toast(|s| s.taskbar_edge);
-                    if is_bottom_toast_check(hwnd, taskbar_edge) {
-                        with_toast_mut(|state| {
-                            state.is_bottom_toast = true;
-                        });
-                        let _ = KillTimer(Some(hwnd), TIMER_CHECK_BOTTOM);
-                        SetTimer(Some(hwnd), TIMER_START_FADE, DISPLAY_MS, None);
-                    }
+                    with_toast_mut(|state| state.fade_start = Some(Instant::now()));
+                    crate::animation::start(hwnd);
                 }
                 _ => {}
             }
@@ -351,16 +535,16 @@ unsafe extern "system" fn wnd_proc(
             let x = (lparam.0 & 0xFFFF) as i16 as i32;
             let y = ((lparam.0 >> 16) & 0xFFFF) as i16 as i32;
 
-            if is_point_in_close_button(x, y) {
+            if is_point_in_close_button(&with_toast(|s| s.layout), x, y) {
                 // Close button click
                 let _ = KillTimer(Some(hwnd), TIMER_START_FADE);
-                let _ = KillTimer(Some(hwnd), TIMER_FADE);
+                crate::animation::stop(hwnd);
                 notify_other_toasts_closing(hwnd);
                 let _ = DestroyWindow(hwnd);
             } else {
                 // Body click: activate window
                 let _ = KillTimer(Some(hwnd), TIMER_START_FADE);
-                let _ = KillTimer(Some(hwnd), TIMER_FADE);
+                crate::animation::stop(hwnd);
                 notify_other_toasts_closing(hwnd);
                 let _ = ShowWindow(hwnd, SW_HIDE);
 
@@ -378,7 +562,7 @@ unsafe extern "system" fn wnd_proc(
         WM_RBUTTONUP => {
             // Right click: close without activation
             let _ = KillTimer(Some(hwnd), TIMER_START_FADE);
-            let _ = KillTimer(Some(hwnd), TIMER_FADE);
+            crate::animation::stop(hwnd);
             notify_other_toasts_closing(hwnd);
             let _ = DestroyWindow(hwnd);
             LRESULT(0)
@@ -411,40 +595,44 @@ unsafe extern "system" fn wnd_proc(
         }
 
         x if x == WM_TOAST_CHECK_POSITION => {
-            let closed_toast_y = wparam.0 as i32;
+            // Coalesce: several toasts closing at once queue several
+            // requests; one pass against the current registry covers them all.
+            let mut pending = MSG::default();
+            while PeekMessageW(
+                &mut pending,
+                Some(hwnd),
+                WM_TOAST_CHECK_POSITION,
+                WM_TOAST_CHECK_POSITION,
+                PM_REMOVE,
+            ).as_bool() {}
+
+            // Not in the registry: this toast is closing itself
+            let Some(rank) = crate::registry::rank(hwnd) else { return LRESULT(0) };
+
             let mut my_rect = RECT::default();
             let _ = GetWindowRect(hwnd, &mut my_rect);
 
-            let taskbar_edge = with_toast(|s| s.taskbar_edge);
-
-            // Update position target (borrow released before is_bottom_toast_check)
-            with_toast_mut(|state| {
-                if state.taskbar_edge == ABE_TOP as u32 {
-                    // Top taskbar: if we're below the closed toast, move up
-                    if my_rect.top > closed_toast_y {
-                        state.target_y = my_rect.top - WINDOW_HEIGHT;
-                        SetTimer(Some(hwnd), TIMER_REPOSITION, 16, None);
-                    }
-                } else {
-                    // Bottom taskbar: if we're above the closed toast, move down
-                    if my_rect.top < closed_toast_y {
-                        state.target_y = my_rect.top + WINDOW_HEIGHT;
-                        SetTimer(Some(hwnd), TIMER_REPOSITION, 16, None);
-                    }
+            let now = Instant::now();
+            let moving = with_toast_mut(|state| {
+                let to_y = slot_y(&state.work_area, state.taskbar_edge, state.layout.height, rank);
+                // A slide already under way is retargeted from where it is now
+                let moving = to_y != my_rect.top;
+                if moving {
+                    state.slide = Some(Slide { from_y: my_rect.top, to_y, start: now });
                 }
-            });
 
-            // Check bottom toast status OUTSIDE the borrow to avoid double-borrow
-            // (is_bottom_toast_check -> enum_other_toasts -> callback borrows TOAST)
-            let is_already_bottom = with_toast(|s| s.is_bottom_toast);
-            if !is_already_bottom && is_bottom_toast_check(hwnd, taskbar_edge) {
-                with_toast_mut(|state| {
+                // Rank 0 means we are now the bottom toast and own the
+                // auto-dismiss timer.
+                if rank == 0 && !state.is_bottom_toast {
                     state.is_bottom_toast = true;
-                    let _ = KillTimer(Some(hwnd), TIMER_CHECK_BOTTOM);
                     if !state.mouse_inside {
                         SetTimer(Some(hwnd), TIMER_START_FADE, DISPLAY_MS, None);
                     }
-                });
+                }
+                moving
+            });
+            if moving {
+                crate::animation::start(hwnd);
             }
 
             LRESULT(0)
@@ -453,26 +641,83 @@ unsafe extern "system" fn wnd_proc(
         x if x == WM_TOAST_PAUSE_TIMER => {
             let pause = wparam.0 == 1;
 
-            with_toast_mut(|state| {
+            let restored = with_toast_mut(|state| {
                 if pause {
-                    if state.is_fading {
-                        let _ = KillTimer(Some(hwnd), TIMER_FADE);
-                        state.is_fading = false;
+                    let _ = KillTimer(Some(hwnd), TIMER_START_FADE);
+                    if state.fade_start.take().is_some() {
                         state.alpha = INITIAL_ALPHA;
-                        let _ = SetLayeredWindowAttributes(hwnd, COLORREF(0), INITIAL_ALPHA, LWA_ALPHA);
+                        return true;
                     }
-                    let _ = KillTimer(Some(hwnd), TIMER_START_FADE);
                 } else {
                     // Resume: only start fade timer if bottom toast and mouse not inside
                     if state.is_bottom_toast && !state.mouse_inside {
                         SetTimer(Some(hwnd), TIMER_START_FADE, DISPLAY_MS, None);
                     }
                 }
+                false
+            });
+            if restored {
+                present_toast();
+            }
+            LRESULT(0)
+        }
+
+        x if x == crate::animation::WM_ANIMATION_FRAME => {
+            // Frames queued while this toast was busy are stale; draw once
+            let mut pending = MSG::default();
+            while PeekMessageW(
+                &mut pending,
+                Some(hwnd),
+                crate::animation::WM_ANIMATION_FRAME,
+                crate::animation::WM_ANIMATION_FRAME,
+                PM_REMOVE,
+            ).as_bool() {}
+
+            animation_frame(hwnd);
+            LRESULT(0)
+        }
+
+        WM_DPICHANGED => {
+            // Moved to a monitor with another scale: rebuild at the new DPI
+            // rather than let the system stretch the old bitmap.
+            let dpi = (wparam.0 & 0xFFFF) as u32;
+            let suggested = *(lparam.0 as *const RECT);
+            invalidate_monitor_cache();
+            let metrics = monitor_metrics(MonitorFromWindow(hwnd, MONITOR_DEFAULTTONEAREST));
+
+            let layout = with_toast_mut(|state| {
+                state.layout = layout_for_dpi(dpi);
+                state.work_area = metrics.work_area;
+                if state.icon.as_ref().is_some_and(|icon| icon.size != state.layout.icon_size) {
+                    state.icon = crate::assets::exe_icon(&state.icon_path, state.layout.icon_size);
+                }
+                state.back_buffer = render(state);
+                state.layout
             });
+            let _ = SetWindowPos(
+                hwnd,
+                None,
+                suggested.left, suggested.top, layout.width, layout.height,
+                SWP_NOZORDER | SWP_NOACTIVATE,
+            );
+            present_toast();
+
+            // Slot heights changed; settle into the right slot
+            let _ = PostMessageW(Some(hwnd), WM_TOAST_CHECK_POSITION, WPARAM(0), LPARAM(0));
             LRESULT(0)
         }
 
+        WM_DISPLAYCHANGE | WM_SETTINGCHANGE => {
+            invalidate_monitor_cache();
+            DefWindowProcW(hwnd, msg, wparam, lparam)
+        }
+
         WM_DESTROY => {
+            crate::animation::stop(hwnd);
+            crate::registry::unregister(hwnd);
+            // Never shown: dropping it tells the sender nothing was applied
+            drop(take_update(hwnd));
+            with_toast_mut(|state| state.back_buffer = None);
             PostQuitMessage(0);
             LRESULT(0)
         }
@@ -481,121 +726,276 @@ unsafe extern "system" fn wnd_proc(
     }
 }
 
-// --- Paint ---
+/// Show the content waiting for `hwnd` and restart its display time.
+unsafe fn apply_update(hwnd: HWND) {
+    let Ok(live) = TOAST.with(|cell| cell.try_borrow_mut().map(|s| s.is_some())) else {
+        // Re-entered while the state is borrowed: go round the queue again
+        let _ = PostMessageW(Some(hwnd), WM_TOAST_UPDATE, WPARAM(0), LPARAM(0));
+        return;
+    };
+    let Some(ToastUpdate { title, message, applied }) = take_update(hwnd) else { return };
+    if !live {
+        return;
+    }
 
-unsafe fn paint(hwnd: HWND) {
-    let (title, message, input_mode, font_family, icon, default_icon_path) = with_toast(|state| {
-        (
-            state.title.clone(),
-            state.message.clone(),
-            state.input_mode,
-            state.font_family.clone(),
-            state.icon,
-            state.default_icon_path.clone(),
-        )
+    let restart_timer = with_toast_mut(|state| {
+        state.title = title;
+        state.message = message;
+        // A fading toast is brought back; the clock stops on its own
+        state.fade_start = None;
+        state.alpha = INITIAL_ALPHA;
+        state.back_buffer = render(state);
+        state.is_bottom_toast && !state.mouse_inside
     });
+    present_toast();
+    if restart_timer {
+        // Same id: replaces the running timer, so the countdown restarts
+        SetTimer(Some(hwnd), TIMER_START_FADE, DISPLAY_MS, None);
+    }
+    applied();
+}
 
-    let mut ps = PAINTSTRUCT::default();
-    let hdc = BeginPaint(hwnd, &mut ps);
+// --- Rendering ---
+
+/// Off-screen 32bpp DIB holding the fully rendered toast. Pushed to the
+/// screen with UpdateLayeredWindow; fade frames only change the blend alpha.
+struct BackBuffer {
+    dc: HDC,
+    bitmap: HBITMAP,
+    old_bitmap: HGDIOBJ,
+    bits: *mut u32,
+    width: i32,
+    height: i32,
+}
+
+impl Drop for BackBuffer {
+    fn drop(&mut self) {
+        unsafe {
+            SelectObject(self.dc, self.old_bitmap);
+            let _ = DeleteObject(HGDIOBJ(self.bitmap.0));
+            let _ = DeleteDC(self.dc);
+        }
+    }
+}
+
+/// Push the back buffer to the layered window at the current alpha.
+///
+/// Called with the toast state unborrowed: a size change makes
+/// UpdateLayeredWindow send messages straight back to `wnd_proc`.
+fn present_toast() {
+    let Some((hwnd, dc, size, alpha)) = with_toast(|state| {
+        state.back_buffer.as_ref().map(|buffer| {
+            (state.hwnd, buffer.dc, SIZE { cx: buffer.width, cy: buffer.height }, state.alpha)
+        })
+    }) else {
+        return;
+    };
+    let src = POINT { x: 0, y: 0 };
+    let blend = BLENDFUNCTION {
+        BlendOp: AC_SRC_OVER as u8,
+        BlendFlags: 0,
+        SourceConstantAlpha: alpha,
+        AlphaFormat: AC_SRC_ALPHA as u8,
+    };
+    unsafe {
+        let _ = UpdateLayeredWindow(
+            hwnd,
+            None,
+            None,
+            Some(&size),
+            Some(dc),
+            Some(&src),
+            COLORREF(0),
+            Some(&blend),
+            ULW_ALPHA,
+        );
+    }
+}
+
+/// Render the toast content into a new back buffer.
+unsafe fn render(state: &ToastState) -> Option<BackBuffer> {
+    let buffer = new_back_buffer(state.layout.width, state.layout.height)?;
+    draw_chrome(buffer.dc, &state.layout, state.input_mode);
+    draw_body(&buffer, state);
+    Some(buffer)
+}
+
+/// Allocate an empty top-down 32bpp back buffer.
+unsafe fn new_back_buffer(width: i32, height: i32) -> Option<BackBuffer> {
+    let dc = CreateCompatibleDC(None);
+    if dc.is_invalid() {
+        return None;
+    }
+
+    let bmi = BITMAPINFO {
+        bmiHeader: BITMAPINFOHEADER {
+            biSize: std::mem::size_of::<BITMAPINFOHEADER>() as u32,
+            biWidth: width,
+            biHeight: -height, // top-down
+            biPlanes: 1,
+            biBitCount: 32,
+            biCompression: BI_RGB.0,
+            ..Default::default()
+        },
+        ..Default::default()
+    };
+    let mut bits: *mut core::ffi::c_void = std::ptr::null_mut();
+    let bitmap = match CreateDIBSection(Some(dc), &bmi, DIB_RGB_COLORS, &mut bits, None, 0) {
+        Ok(b) if !bits.is_null() => b,
+        _ => {
+            let _ = DeleteDC(dc);
+            return None;
+        }
+    };
+    let old_bitmap = SelectObject(dc, HGDIOBJ(bitmap.0));
+
+    Some(BackBuffer { dc, bitmap, old_bitmap, bits: bits as *mut u32, width, height })
+}
+
+fn icon_origin(layout: &Layout) -> (i32, i32) {
+    (layout.icon_padding, (layout.height - layout.icon_size) / 2)
+}
+
+/// Composite a premultiplied icon bitmap over the opaque background.
+fn blend_icon(pixels: &mut [u32], width: i32, height: i32, x: i32, y: i32, icon: &crate::assets::IconBitmap) {
+    for row in 0..icon.size {
+        let dy = y + row;
+        if dy < 0 || dy >= height {
+            continue;
+        }
+        for col in 0..icon.size {
+            let dx = x + col;
+            if dx < 0 || dx >= width {
+                continue;
+            }
+            let src = icon.pixels[(row * icon.size + col) as usize];
+            let inv = 255 - (src >> 24);
+            if inv == 255 {
+                continue;
+            }
+            let dst = &mut pixels[(dy * width + dx) as usize];
+            let mut out = 0u32;
+            for shift in [0, 8, 16] {
+                let s = (src >> shift) & 0xFF;
+                let d = (*dst >> shift) & 0xFF;
+                out |= (s + d * inv / 255).min(255) << shift;
+            }
+            *dst = out;
+        }
+    }
+}
+
+/// Draw the parts that depend only on layout and style: background,
+/// border and close button.
+unsafe fn draw_chrome(hdc: HDC, l: &Layout, input_mode: bool) {
+    let (width, height) = (l.width, l.height);
 
     // Background
-    let bg = CreateSolidBrush(COLORREF(COLOR_BG));
-    let rect = RECT { left: 0, top: 0, right: WINDOW_WIDTH, bottom: WINDOW_HEIGHT };
-    FillRect(hdc, &rect, bg);
-    let _ = DeleteObject(HGDIOBJ(bg.0));
+    let rect = RECT { left: 0, top: 0, right: width, bottom: height };
+    FillRect(hdc, &rect, cached_brush(COLOR_BG));
 
     // Border (color depends on input mode)
     let border_color = if input_mode { COLOR_BORDER_INPUT } else { COLOR_BORDER_NORMAL };
-    let border = CreateSolidBrush(COLORREF(border_color));
+    let border = cached_brush(border_color);
     let borders = [
-        RECT { left: 0, top: 0, right: WINDOW_WIDTH, bottom: BORDER_WIDTH },
-        RECT { left: 0, top: WINDOW_HEIGHT - BORDER_WIDTH, right: WINDOW_WIDTH, bottom: WINDOW_HEIGHT },
-        RECT { left: 0, top: 0, right: BORDER_WIDTH, bottom: WINDOW_HEIGHT },
-        RECT { left: WINDOW_WIDTH - BORDER_WIDTH, top: 0, right: WINDOW_WIDTH, bottom: WINDOW_HEIGHT },
+        RECT { left: 0, top: 0, right: width, bottom: l.border },
+        RECT { left: 0, top: height - l.border, right: width, bottom: height },
+        RECT { left: 0, top: 0, right: l.border, bottom: height },
+        RECT { left: width - l.border, top: 0, right: width, bottom: height },
     ];
     for b in &borders {
         FillRect(hdc, b, border);
     }
-    let _ = DeleteObject(HGDIOBJ(border.0));
-
-    // Icon
-    let icon_x = ICON_PADDING;
-    let icon_y = (WINDOW_HEIGHT - ICON_SIZE) / 2;
-    if !icon.is_invalid() {
-        let _ = DrawIconEx(
-            hdc, icon_x, icon_y,
-            icon,
-            ICON_SIZE, ICON_SIZE,
-            0, None, DI_NORMAL,
-        );
-    } else if !default_icon_path.is_empty() {
-        let path_wide = crate::util::encode_wide(&default_icon_path);
-        let result = LoadImageW(
-            None,
-            PCWSTR(path_wide.as_ptr()),
-            IMAGE_ICON,
-            ICON_SIZE, ICON_SIZE,
-            LR_LOADFROMFILE,
-        );
-        if let Ok(handle) = result {
-            let h_icon = HICON(handle.0);
-            if !h_icon.is_invalid() {
-                let _ = DrawIconEx(hdc, icon_x, icon_y, h_icon, ICON_SIZE, ICON_SIZE, 0, None, DI_NORMAL);
-                let _ = DestroyIcon(h_icon);
-            }
+
+    // Close button (always Segoe UI)
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, COLORREF(COLOR_CLOSE));
+    let close_font = cached_font(l.close_font, true, "Segoe UI");
+    let old = SelectObject(hdc, HGDIOBJ(close_font.0));
+    let btn_left = width - l.close_margin - l.close_size;
+    let mut close_rect = RECT {
+        left: btn_left,
+        top: l.close_margin,
+        right: btn_left + l.close_size,
+        bottom: l.close_margin + l.close_size,
+    };
+    let mut close_buf = crate::util::encode_wide("\u{00D7}");
+    let close_len = close_buf.len() - 1;
+    DrawTextW(
+        hdc,
+        &mut close_buf[..close_len],
+        &mut close_rect,
+        DT_CENTER | DT_VCENTER | DT_SINGLELINE,
+    );
+    SelectObject(hdc, old);
+}
+
+/// Draw icon, title and message over the chrome, then fix up alpha.
+unsafe fn draw_body(buffer: &BackBuffer, state: &ToastState) {
+    let hdc = buffer.dc;
+    let title = &state.title;
+    let message = &state.message;
+    let font_family = &state.font_family;
+    let default_icon_path = &state.default_icon_path;
+    let l = &state.layout;
+    let width = l.width;
+    let height = l.height;
+
+    // Icon (the caller exe bitmap is blended in below)
+    let (icon_x, icon_y) = icon_origin(l);
+    if state.icon.is_none() && !default_icon_path.is_empty() {
+        let h_icon = crate::assets::default_icon(default_icon_path, l.icon_size);
+        if !h_icon.is_invalid() {
+            let _ = DrawIconEx(hdc, icon_x, icon_y, h_icon, l.icon_size, l.icon_size, 0, None, DI_NORMAL);
         }
     }
 
     // Text setup
     SetBkMode(hdc, TRANSPARENT);
 
-    let text_left = icon_x + ICON_SIZE + ICON_PADDING;
+    let text_left = icon_x + l.icon_size + l.icon_padding;
 
     // Title
     SetTextColor(hdc, COLORREF(COLOR_TITLE));
-    let title_font = make_font(18, true, &font_family);
+    let title_font = cached_font(l.title_font, true, font_family);
     let old = SelectObject(hdc, HGDIOBJ(title_font.0));
-    let mut title_rect = RECT { left: text_left, top: 15, right: WINDOW_WIDTH - 10, bottom: 40 };
-    let mut title_buf = crate::util::encode_wide(&title);
+    let mut title_rect = RECT {
+        left: text_left,
+        top: l.title_top,
+        right: width - l.text_margin,
+        bottom: l.title_bottom,
+    };
+    let mut title_buf = crate::util::encode_wide(title);
     let title_len = title_buf.len() - 1; // exclude null terminator
     DrawTextW(hdc, &mut title_buf[..title_len], &mut title_rect, DRAW_TEXT_FORMAT(0));
     SelectObject(hdc, old);
-    let _ = DeleteObject(HGDIOBJ(title_font.0));
 
     // Message
     SetTextColor(hdc, COLORREF(COLOR_MESSAGE));
-    let msg_font = make_font(14, false, &font_family);
+    let msg_font = cached_font(l.message_font, false, font_family);
     let old = SelectObject(hdc, HGDIOBJ(msg_font.0));
-    let mut msg_rect = RECT { left: text_left, top: 42, right: WINDOW_WIDTH - 10, bottom: WINDOW_HEIGHT - 10 };
-    let mut msg_buf = crate::util::encode_wide(&message);
+    let mut msg_rect = RECT {
+        left: text_left,
+        top: l.message_top,
+        right: width - l.text_margin,
+        bottom: height - l.text_margin,
+    };
+    let mut msg_buf = crate::util::encode_wide(message);
     let msg_len = msg_buf.len() - 1; // exclude null terminator
     DrawTextW(hdc, &mut msg_buf[..msg_len], &mut msg_rect, DRAW_TEXT_FORMAT(0));
     SelectObject(hdc, old);
-    let _ = DeleteObject(HGDIOBJ(msg_font.0));
 
-    // Close button (always Segoe UI)
-    SetTextColor(hdc, COLORREF(COLOR_CLOSE));
-    let close_font = make_font(16, true, "Segoe UI");
-    let old = SelectObject(hdc, HGDIOBJ(close_font.0));
-    let btn_left = WINDOW_WIDTH - CLOSE_BUTTON_MARGIN - CLOSE_BUTTON_SIZE;
-    let mut close_rect = RECT {
-        left: btn_left,
-        top: CLOSE_BUTTON_MARGIN,
-        right: btn_left + CLOSE_BUTTON_SIZE,
-        bottom: CLOSE_BUTTON_MARGIN + CLOSE_BUTTON_SIZE,
-    };
-    let mut close_buf = crate::util::encode_wide("\u{00D7}");
-    let close_len = close_buf.len() - 1;
-    DrawTextW(
-        hdc,
-        &mut close_buf[..close_len],
-        &mut close_rect,
-        DT_CENTER | DT_VCENTER | DT_SINGLELINE,
-    );
-    SelectObject(hdc, old);
-    let _ = DeleteObject(HGDIOBJ(close_font.0));
+    let _ = GdiFlush();
+    let pixels = std::slice::from_raw_parts_mut(buffer.bits, (buffer.width * buffer.height) as usize);
+    if let Some(ref icon) = state.icon {
+        blend_icon(pixels, buffer.width, buffer.height, icon_x, icon_y, icon);
+    }
 
-    let _ = EndPaint(hwnd, &ps);
+    // GDI leaves the alpha channel at 0; the toast is fully opaque, so set
+    // it to 255 and let SourceConstantAlpha drive the fade.
+    for px in pixels.iter_mut() {
+        *px |= 0xFF00_0000;
+    }
 }
 
 // --- Public API ---
@@ -605,24 +1005,126 @@ pub struct ToastParams {
     pub message: String,
     pub input_mode: bool,
     pub font_family: String,
-    pub icon: HICON,
+    pub icon: Option<Arc<crate::assets::IconBitmap>>,
+    /// Exe the icon came from, to re-rasterize it after a DPI change
+    pub icon_path: String,
     pub default_icon_path: String,
     pub target_hwnd: HWND,
     pub wt_hwnd: HWND,
     pub wt_runtime_id: String,
+    /// Registry key for `update_toast`; empty if the toast is never updated
+    pub dedup_key: String,
+}
+
+/// Replace the title and message of the live toast registered under `key`
+/// and restart its display time. `applied` runs on the toast's thread once
+/// the new content is on screen, and is dropped unrun if the toast closes
+/// first or a newer update replaces this one. Returns false if there is no
+/// such toast.
+pub fn update_toast(
+    key: &str,
+    title: String,
+    message: String,
+    applied: impl FnOnce() + Send + 'static,
+) -> bool {
+    let Some(hwnd) = crate::registry::find(key) else { return false };
+    {
+        let mut updates = UPDATES.lock().unwrap_or_else(|e| e.into_inner());
+        // Also drops updates left for windows that are already gone
+        updates.retain(|(h, _)| {
+            *h != hwnd.0 as isize && unsafe { IsWindow(Some(HWND(*h as *mut _))).as_bool() }
+        });
+        let applied = Box::new(applied);
+        updates.push((hwnd.0 as isize, ToastUpdate { title, message, applied }));
+    }
+    let posted = unsafe {
+        PostMessageW(Some(hwnd), WM_TOAST_UPDATE, WPARAM(0), LPARAM(0))
+    }.is_ok();
+    if !posted {
+        drop(take_update(hwnd));
+    }
+    posted
+}
+
+fn register_toast_class() {
+    unsafe {
+        let instance = GetModuleHandleW(None).unwrap_or_default();
+        let class_wide = crate::util::encode_wide(TOAST_CLASS_NAME);
+
+        let wc = WNDCLASSEXW {
+            cbSize: std::mem::size_of::<WNDCLASSEXW>() as u32,
+            lpfnWndProc: Some(wnd_proc),
+            hInstance: instance.into(),
+            lpszClassName: PCWSTR(class_wide.as_ptr()),
+            hCursor: LoadCursorW(None, IDC_HAND).unwrap_or_default(),
+            ..Default::default()
+        };
+
+        // OK if already registered by another toast instance
+        let _ = RegisterClassExW(&wc);
+    }
+}
+
+fn create_toast_window(x: i32, y: i32, layout: &Layout) -> HWND {
+    unsafe {
+        let instance = GetModuleHandleW(None).unwrap_or_default();
+        let class_wide = crate::util::encode_wide(TOAST_CLASS_NAME);
+        CreateWindowExW(
+            WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_LAYERED | WS_EX_NOACTIVATE,
+            PCWSTR(class_wide.as_ptr()),
+            w!("Toast"),
+            WS_POPUP,
+            x, y, layout.width, layout.height,
+            None, None, Some(instance.into()), None,
+        ).unwrap_or_default()
+    }
+}
+
+/// Create this thread's toast window ahead of time, hidden, with a back
+/// buffer for the cursor monitor's DPI and the chrome of the given style
+/// already drawn. The next `show_toast` on this thread with the same style
+/// and DPI uses it. The thread must pump messages until then.
+pub fn prepare_toast(input_mode: bool) {
+    register_toast_class();
+    let layout = layout_for_dpi(cursor_monitor_metrics().dpi);
+
+    let hwnd = create_toast_window(0, 0, &layout);
+    if hwnd.is_invalid() {
+        return;
+    }
+    let Some(buffer) = (unsafe { new_back_buffer(layout.width, layout.height) }) else {
+        unsafe { let _ = DestroyWindow(hwnd); }
+        return;
+    };
+    unsafe { draw_chrome(buffer.dc, &layout, input_mode); }
+
+    let stale = PREPARED.with(|cell| cell.borrow_mut().replace(Prepared { hwnd, layout, input_mode, buffer }));
+    if let Some(stale) = stale {
+        unsafe { let _ = DestroyWindow(stale.hwnd); }
+    }
 }
 
 /// Show the toast notification window. Blocks until the window is closed.
 pub fn show_toast(params: ToastParams) {
-    // Calculate fade step (SPEC 10.3)
-    let fade_ticks = (FADE_MS / 16).max(1);
-    let fade_step = ((INITIAL_ALPHA as u32 / fade_ticks) + 1).min(255) as u8;
-
+    let dedup_key = params.dedup_key;
     // Detect taskbar position
     let taskbar_edge = detect_taskbar_edge();
 
-    // Get work area from cursor's monitor
-    let (work_area, _monitor) = get_cursor_monitor_work_area();
+    // Work area and DPI of the cursor's monitor
+    let metrics = cursor_monitor_metrics();
+    let work_area = metrics.work_area;
+    let layout = layout_for_dpi(metrics.dpi);
+
+    // Use the prepared window if it matches; drop it before toast state
+    // exists so its WM_DESTROY does not end this toast's message loop
+    let prepared = PREPARED.with(|cell| cell.borrow_mut().take()).and_then(|p| {
+        if p.layout.dpi == layout.dpi && p.input_mode == params.input_mode {
+            Some(p)
+        } else {
+            unsafe { let _ = DestroyWindow(p.hwnd); }
+            None
+        }
+    });
 
     TOAST.with(|cell| {
         *cell.borrow_mut() = Some(ToastState {
@@ -632,68 +1134,81 @@ pub fn show_toast(params: ToastParams) {
             input_mode: params.input_mode,
             font_family: params.font_family,
             icon: params.icon,
+            icon_path: params.icon_path,
             default_icon_path: params.default_icon_path,
+            layout,
             target_hwnd: params.target_hwnd,
             wt_hwnd: params.wt_hwnd,
             wt_runtime_id: params.wt_runtime_id,
             alpha: INITIAL_ALPHA,
-            fade_step,
-            is_fading: false,
+            fade_start: None,
             mouse_inside: false,
-            target_y: 0,
+            work_area,
+            slide: None,
             is_bottom_toast: false,
             taskbar_edge,
             clicked: false,
+            back_buffer: None,
         });
     });
 
     unsafe {
-        let instance = GetModuleHandleW(None).unwrap_or_default();
-        let class_wide = crate::util::encode_wide(TOAST_CLASS_NAME);
-
-        let wc = WNDCLASSEXW {
-            cbSize: std::mem::size_of::<WNDCLASSEXW>() as u32,
-            lpfnWndProc: Some(wnd_proc),
-            hInstance: instance.into(),
-            lpszClassName: PCWSTR(class_wide.as_ptr()),
-            hCursor: LoadCursorW(None, IDC_HAND).unwrap_or_default(),
-            ..Default::default()
+        let (x, y) = calculate_position(&work_area, taskbar_edge, &layout);
+
+        let (hwnd, buffer) = match prepared {
+            Some(p) => {
+                let _ = SetWindowPos(
+                    p.hwnd,
+                    None,
+                    x, y, layout.width, layout.height,
+                    SWP_NOZORDER | SWP_NOACTIVATE,
+                );
+                (p.hwnd, Some(p.buffer))
+            }
+            None => {
+                register_toast_class();
+                (create_toast_window(x, y, &layout), None)
+            }
         };
 
-        // OK if already registered by another toast instance
-        let _ = RegisterClassExW(&wc);
-
-        let (x, y) = calculate_position(&work_area, taskbar_edge);
-
-        let hwnd = CreateWindowExW(
-            WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_LAYERED | WS_EX_NOACTIVATE,
-            PCWSTR(class_wide.as_ptr()),
-            w!("Toast"),
-            WS_POPUP,
-            x, y, WINDOW_WIDTH, WINDOW_HEIGHT,
-            None, None, Some(instance.into()), None,
-        ).unwrap_or_default();
-
         if hwnd.is_invalid() || hwnd == HWND::default() {
             crate::debug_log!("CreateWindowExW failed");
             return;
         }
 
         with_toast_mut(|state| state.hwnd = hwnd);
+        crate::etw_event!("toast window {}: {:?}", if buffer.is_some() { "from pool" } else { "created" }, hwnd);
+        crate::registry::register(hwnd, &dedup_key);
+
+        // Render once; the layered window must have content before it is shown.
+        // A prepared buffer already has the chrome; only the body is drawn.
+        let first_paint = crate::log::span("first paint");
+        with_toast_mut(|state| {
+            state.back_buffer = match buffer {
+                Some(buffer) => {
+                    draw_body(&buffer, state);
+                    Some(buffer)
+                }
+                None => render(state),
+            };
+        });
+        present_toast();
 
-        let _ = SetLayeredWindowAttributes(hwnd, COLORREF(0), INITIAL_ALPHA, LWA_ALPHA);
-
-        // Determine if bottom toast and start appropriate timer
-        if is_bottom_toast_check(hwnd, taskbar_edge) {
+        // Only the bottom toast starts the fade timer. Upper toasts wait to
+        // be told their new rank via WM_TOAST_CHECK_POSITION; no polling.
+        if is_bottom_toast_check(hwnd) {
             with_toast_mut(|state| state.is_bottom_toast = true);
             SetTimer(Some(hwnd), TIMER_START_FADE, DISPLAY_MS, None);
         } else {
             with_toast_mut(|state| state.is_bottom_toast = false);
-            SetTimer(Some(hwnd), TIMER_CHECK_BOTTOM, 200, None);
         }
 
         let _ = ShowWindow(hwnd, SW_SHOWNOACTIVATE);
-        let _ = UpdateWindow(hwnd);
+        drop(first_paint);
+        crate::etw_event!("toast first paint: {:?}", hwnd);
+        crate::host::toast_shown();
+        // Sound is already in memory, so it starts in the same frame
+        crate::assets::play_sound();
 
         // Message loop
         let mut msg = MSG::default();
@@ -705,31 +1220,19 @@ pub fn show_toast(params: ToastParams) {
 }
 
 fn detect_taskbar_edge() -> u32 {
-    let mut abd = APPBARDATA {
-        cbSize: std::mem::size_of::<APPBARDATA>() as u32,
-        ..Default::default()
-    };
-
-    let result = unsafe { SHAppBarMessage(ABM_GETTASKBARPOS, &mut abd) };
-    if result != 0 {
-        abd.uEdge
-    } else {
-        ABE_BOTTOM as u32
-    }
-}
-
-fn get_cursor_monitor_work_area() -> (RECT, HMONITOR) {
-    unsafe {
-        let mut cursor_pos = POINT::default();
-        let _ = GetCursorPos(&mut cursor_pos);
-
-        let monitor = MonitorFromPoint(cursor_pos, MONITOR_DEFAULTTOPRIMARY);
-        let mut mi = MONITORINFO {
-            cbSize: std::mem::size_of::<MONITORINFO>() as u32,
-            ..Default::default()
-        };
-        let _ = GetMonitorInfoW(monitor, &mut mi);
-
-        (mi.rcWork, monitor)
-    }
+    with_monitor_cache(|cache| {
+        *cache.taskbar_edge.get_or_insert_with(|| {
+            let mut abd = APPBARDATA {
+                cbSize: std::mem::size_of::<APPBARDATA>() as u32,
+                ..Default::default()
+            };
+
+            let result = unsafe { SHAppBarMessage(ABM_GETTASKBARPOS, &mut abd) };
+            if result != 0 {
+                abd.uEdge
+            } else {
+                ABE_BOTTOM as u32
+            }
+        })
+    })
 }
@@ -1,50 +1,177 @@
 //! UI Automation COM interface for Windows Terminal tab detection.
 //!
 //! Uses IUIAutomation to enumerate tabs, find the selected one,
-//! and capture/match its RuntimeId.
+//! and capture/match its RuntimeId. Tab properties are fetched through a
+//! cache request, and the automation object is reused per thread.
+//! Tab selection on click runs on a pre-warmed MTA worker thread so it
+//! overlaps with foreground activation; the clicking thread never waits
+//! for it, only process exit does.
+
+use std::cell::RefCell;
+use std::sync::mpsc;
+use std::sync::Mutex;
+use std::time::Duration;
 
 use windows::core::*;
 use windows::Win32::Foundation::*;
 use windows::Win32::System::Com::*;
-use windows::Win32::System::Ole::*;
 use windows::Win32::System::Variant::*;
 use windows::Win32::UI::Accessibility::*;
 
-/// Get the RuntimeId string of the currently selected WT tab.
-/// Returns empty string on failure.
-pub fn get_selected_tab_runtime_id(hwnd: HWND) -> String {
-    unsafe { get_selected_tab_runtime_id_inner(hwnd).unwrap_or_default() }
+thread_local! {
+    /// Automation object reused for every call on this thread.
+    static AUTOMATION: RefCell<Option<IUIAutomation>> = const { RefCell::new(None) };
 }
 
-unsafe fn get_selected_tab_runtime_id_inner(hwnd: HWND) -> Result<String> {
-    let automation: IUIAutomation = CoCreateInstance(
-        &CUIAutomation as *const GUID,
-        None,
-        CLSCTX_INPROC_SERVER,
-    )?;
+unsafe fn automation() -> Result<IUIAutomation> {
+    AUTOMATION.with(|cell| {
+        if let Some(automation) = cell.borrow().as_ref() {
+            return Ok(automation.clone());
+        }
+        let automation: IUIAutomation = CoCreateInstance(
+            &CUIAutomation as *const GUID,
+            None,
+            CLSCTX_INPROC_SERVER,
+        )?;
+        *cell.borrow_mut() = Some(automation.clone());
+        Ok(automation)
+    })
+}
+
+/// Drop this thread's cached automation object. Call before CoUninitialize.
+pub fn release_automation() {
+    AUTOMATION.with(|cell| *cell.borrow_mut() = None);
+}
+
+/// A tab selection handed to the worker thread.
+struct SelectJob {
+    hwnd: isize, // HWND is not Send
+    runtime_id: String,
+    done: mpsc::Sender<bool>,
+}
+
+/// Queue of the tab worker, started by `prewarm_tab_worker`.
+static TAB_WORKER: Mutex<Option<mpsc::Sender<SelectJob>>> = Mutex::new(None);
+
+/// Completion of the latest selection, awaited by `finish_tab_selection`.
+static PENDING_SELECT: Mutex<Option<mpsc::Receiver<bool>>> = Mutex::new(None);
+
+/// How long process exit waits for an unfinished tab selection.
+const TAB_SELECT_TIMEOUT_MS: u64 = 500;
+
+/// Start the tab worker if it is not running yet. The worker creates its
+/// automation object up front, so a later click pays only for the search.
+pub fn prewarm_tab_worker() {
+    let mut worker = TAB_WORKER.lock().unwrap_or_else(|e| e.into_inner());
+    if worker.is_some() {
+        return;
+    }
+
+    let (tx, rx) = mpsc::channel::<SelectJob>();
+    let spawned = std::thread::Builder::new()
+        .name("uia-tabs".to_string())
+        .spawn(move || unsafe {
+            let _ = CoInitializeEx(None, COINIT_MULTITHREADED);
+            let _ = automation();
+            for job in rx {
+                let selected = select_tab_by_runtime_id(HWND(job.hwnd as *mut _), &job.runtime_id);
+                if selected {
+                    crate::debug_log!("WT tab selected successfully");
+                } else {
+                    crate::debug_log!("WT tab not found (may have been closed)");
+                }
+                let _ = job.done.send(selected);
+            }
+            release_automation();
+            CoUninitialize();
+        });
+
+    if spawned.is_ok() {
+        *worker = Some(tx);
+    } else {
+        crate::debug_log!("Failed to start UIA tab worker");
+    }
+}
+
+/// Select a WT tab on the worker thread without waiting for it; the
+/// worker logs whether the tab was found.
+pub fn select_tab_async(hwnd: HWND, runtime_id: &str) {
+    prewarm_tab_worker();
+    let (done, result) = mpsc::channel();
+    let worker = TAB_WORKER.lock().unwrap_or_else(|e| e.into_inner());
+    if let Some(tx) = worker.as_ref() {
+        let _ = tx.send(SelectJob {
+            hwnd: hwnd.0 as isize,
+            runtime_id: runtime_id.to_string(),
+            done,
+        });
+        *PENDING_SELECT.lock().unwrap_or_else(|e| e.into_inner()) = Some(result);
+    }
+}
+
+/// Give a selection still running on the worker a chance to finish.
+/// Call before the process exits, which would otherwise cut it short.
+pub fn finish_tab_selection() {
+    let pending = PENDING_SELECT.lock().unwrap_or_else(|e| e.into_inner()).take();
+    if let Some(result) = pending {
+        if result.recv_timeout(Duration::from_millis(TAB_SELECT_TIMEOUT_MS)).is_err() {
+            crate::debug_log!("WT tab selection timed out");
+        }
+    }
+}
+
+/// Find all WT tab items with IsSelected, the SelectionItem pattern and
+/// RuntimeId prefetched in one cross-process round trip.
+/// The search is limited to the tab row when it can be located.
+unsafe fn find_tabs(automation: &IUIAutomation, hwnd: HWND) -> Result<IUIAutomationElementArray> {
+    let root = automation.ElementFromHandle(hwnd)?;
 
-    let element = automation.ElementFromHandle(hwnd)?;
+    let cache = automation.CreateCacheRequest()?;
+    cache.AddProperty(UIA_RuntimeIdPropertyId)?;
+    cache.AddProperty(UIA_SelectionItemIsSelectedPropertyId)?;
+    cache.AddPattern(UIA_SelectionItemPatternId)?;
 
     // Create condition: ControlType == TabItem
     let prop_id = UIA_ControlTypePropertyId;
     let val = VARIANT::from(UIA_TabItemControlTypeId.0);
-    let condition = automation.CreatePropertyCondition(prop_id, &val)?;
+    let tab_item = automation.CreatePropertyCondition(prop_id, &val)?;
+
+    // The tab row is the first Tab control; searching under it skips the
+    // (much larger) terminal content and split-pane subtrees.
+    let row_val = VARIANT::from(UIA_TabControlTypeId.0);
+    let tab_row = automation.CreatePropertyCondition(prop_id, &row_val)?;
+    match root.FindFirst(TreeScope_Descendants, &tab_row) {
+        Ok(row) => row.FindAllBuildCache(TreeScope_Descendants, &tab_item, &cache),
+        Err(_) => root.FindAllBuildCache(TreeScope_Descendants, &tab_item, &cache),
+    }
+}
 
-    // Find all tab items
-    let tabs = element.FindAll(TreeScope_Descendants, &condition)?;
+/// Get the RuntimeId string of the currently selected WT tab.
+/// Returns empty string on failure.
+pub fn get_selected_tab_runtime_id(hwnd: HWND) -> String {
+    let _span = crate::log::span("uia capture");
+    crate::etw_event!("uia capture begin");
+    let runtime_id = unsafe { get_selected_tab_runtime_id_inner(hwnd).unwrap_or_default() };
+    crate::etw_event!("uia capture end: {}", runtime_id);
+    runtime_id
+}
+
+unsafe fn get_selected_tab_runtime_id_inner(hwnd: HWND) -> Result<String> {
+    let automation = automation()?;
+    let tabs = find_tabs(&automation, hwnd)?;
     let count = tabs.Length()?;
 
     for i in 0..count {
         let tab = tabs.GetElement(i)?;
 
-        // Check if this tab is selected
-        let pattern: Result<IUIAutomationSelectionItemPattern> =
-            tab.GetCurrentPatternAs(UIA_SelectionItemPatternId);
-        if let Ok(pattern) = pattern {
-            let selected = pattern.CurrentIsSelected()?;
-            if selected.as_bool() {
-                return get_runtime_id_string(&tab);
-            }
+        // Check if this tab is selected (cached, no cross-process call)
+        let selected = tab
+            .GetCachedPropertyValue(UIA_SelectionItemIsSelectedPropertyId)
+            .ok()
+            .and_then(|v| bool::try_from(&v).ok())
+            .unwrap_or(false);
+        if selected {
+            return get_runtime_id_string(&tab);
         }
     }
 
@@ -54,23 +181,16 @@ unsafe fn get_selected_tab_runtime_id_inner(hwnd: HWND) -> Result<String> {
 /// Select a WT tab by matching its RuntimeId string.
 /// Returns true if the tab was found and selected.
 pub fn select_tab_by_runtime_id(hwnd: HWND, target_runtime_id: &str) -> bool {
-    unsafe { select_tab_inner(hwnd, target_runtime_id).unwrap_or(false) }
+    let _span = crate::log::span("uia select");
+    crate::etw_event!("uia select begin: {}", target_runtime_id);
+    let selected = unsafe { select_tab_inner(hwnd, target_runtime_id).unwrap_or(false) };
+    crate::etw_event!("uia select end: found={}", selected);
+    selected
 }
 
 unsafe fn select_tab_inner(hwnd: HWND, target_runtime_id: &str) -> Result<bool> {
-    let automation: IUIAutomation = CoCreateInstance(
-        &CUIAutomation as *const GUID,
-        None,
-        CLSCTX_INPROC_SERVER,
-    )?;
-
-    let element = automation.ElementFromHandle(hwnd)?;
-
-    let prop_id = UIA_ControlTypePropertyId;
-    let val = VARIANT::from(UIA_TabItemControlTypeId.0);
-    let condition = automation.CreatePropertyCondition(prop_id, &val)?;
-
-    let tabs = element.FindAll(TreeScope_Descendants, &condition)?;
+    let automation = automation()?;
+    let tabs = find_tabs(&automation, hwnd)?;
     let count = tabs.Length()?;
 
     for i in 0..count {
@@ -79,7 +199,7 @@ unsafe fn select_tab_inner(hwnd: HWND, target_runtime_id: &str) -> Result<bool>
 
         if rid == target_runtime_id {
             let pattern: Result<IUIAutomationSelectionItemPattern> =
-                tab.GetCurrentPatternAs(UIA_SelectionItemPatternId);
+                tab.GetCachedPatternAs(UIA_SelectionItemPatternId);
             if let Ok(pattern) = pattern {
                 let _ = pattern.Select();
                 return Ok(true);
@@ -90,27 +210,27 @@ unsafe fn select_tab_inner(hwnd: HWND, target_runtime_id: &str) -> Result<bool>
     Ok(false)
 }
 
+/// Join a tab's cached RuntimeId into a dotted string. The id comes from the
+/// `FindAllBuildCache` result, so reading it costs no cross-process call.
 unsafe fn get_runtime_id_string(element: &IUIAutomationElement) -> Result<String> {
-    let sa_ptr = element.GetRuntimeId()?;
-    if sa_ptr.is_null() {
+    // Dropping the VARIANT clears it, which destroys the SAFEARRAY it owns.
+    let value = element.GetCachedPropertyValue(UIA_RuntimeIdPropertyId)?;
+    if value.is_empty() {
         return Ok(String::new());
     }
 
-    let lower = SafeArrayGetLBound(sa_ptr, 1)?;
-    let upper = SafeArrayGetUBound(sa_ptr, 1)?;
-
-    let mut parts = Vec::new();
-    for i in lower..=upper {
-        let mut val: i32 = 0;
-        SafeArrayGetElement(
-            sa_ptr,
-            &i as *const i32 as *const _,
-            &mut val as *mut i32 as *mut _,
-        )?;
-        parts.push(val.to_string());
+    let mut ids: *mut i32 = std::ptr::null_mut();
+    let mut count: u32 = 0;
+    VariantToInt32ArrayAlloc(&value, &mut ids, &mut count)?;
+    if ids.is_null() {
+        return Ok(String::new());
     }
 
-    SafeArrayDestroy(sa_ptr)?;
+    let parts: Vec<String> = std::slice::from_raw_parts(ids, count as usize)
+        .iter()
+        .map(|id| id.to_string())
+        .collect();
+    CoTaskMemFree(Some(ids as *const _));
 
     Ok(parts.join("."))
 }
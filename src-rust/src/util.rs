@@ -8,6 +8,14 @@ pub fn encode_wide(s: &str) -> Vec<u16> {
     s.encode_utf16().chain(std::iter::once(0)).collect()
 }
 
+/// Full path of the running executable.
+pub fn exe_path() -> String {
+    std::env::current_exe()
+        .unwrap_or_default()
+        .to_string_lossy()
+        .into_owned()
+}
+
 /// Get the window class name for a given HWND.
 pub fn get_class_name(hwnd: HWND) -> String {
     let mut buf = [0u16; 256];